@@ -0,0 +1,250 @@
+//
+// Memory for the big tables of states
+//
+// A big search stores millions of states.  If we keep them in a
+// std::vector, every time it fills up it allocates an array twice the
+// size and copies everything across, so for a while we need three
+// times the memory, and we spend time copying.  Instead, the lists of
+// states are stored in fixed-size chunks (see ChunkedVector).  When
+// one chunk fills up we just start another, and nothing ever moves.
+//
+// We get the chunks straight from the OS with mmap, in blocks the
+// size of a "huge page" (2MB on x86-64, rather than the usual 4KB).
+// The CPU has to look up the physical address of every page we touch,
+// and it only has room to remember a few thousand of them.  With
+// random access all over hundreds of megabytes of hash table, 4KB
+// pages means most lookups miss, and each miss costs a trip to memory.
+// With 2MB pages, the same number of entries covers 512 times as much.
+// We ask for that in two ways:
+//
+// - MADV_HUGEPAGE asks Linux to use "transparent" huge pages for the
+//   block if it can.  This works on most systems without any setup,
+//   so we always do it.
+// - MAP_HUGETLB asks for pages from a pool of huge pages that the
+//   system administrator has to set aside beforehand
+//   (/proc/sys/vm/nr_hugepages).  So we only try it if asked to (see
+//   ArenaHugePages), and fall back to ordinary pages if the pool is
+//   empty.
+//
+// The solver keeps its tables from one puzzle to the next, and
+// clearing a ChunkedVector just forgets the items, so once the tables
+// have grown to the size of the biggest puzzle, we never need any
+// more memory.  The counters in GetArenaCounters let us check that.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+// Size of a huge page, and of the chunks of a ChunkedVector
+constexpr size_t HUGE_PAGE_BYTES = size_t(2) << 20;
+
+// How much memory we have asked the OS for, since the program started.
+// All of the lists and hash tables of states get their memory through
+// AllocatePages, so if these stop going up, the search has stopped
+// allocating memory.
+struct ArenaCounters
+{
+	// Number of blocks allocated, and their total size
+	std::atomic<uint64_t> allocations { 0 };
+	std::atomic<uint64_t> bytes { 0 };
+
+	// How many of those blocks got pages from the MAP_HUGETLB pool
+	std::atomic<uint64_t> huge_tlb_allocations { 0 };
+};
+
+inline ArenaCounters &GetArenaCounters()
+{
+	static ArenaCounters counters;
+	return counters;
+}
+
+// Set this to ask for pages from the MAP_HUGETLB pool
+inline std::atomic<bool> &ArenaHugePages()
+{
+	static std::atomic<bool> enabled { false };
+	return enabled;
+}
+
+// Allocate a block of memory for a table.  Small blocks come from
+// malloc.  Big ones are mapped directly, lined up on a huge page
+// boundary, with a hint to use huge pages.  The memory is not
+// initialized.  Free it with FreePages, passing the same size.
+inline void *AllocatePages( size_t bytes )
+{
+	ArenaCounters &counters = GetArenaCounters();
+	counters.allocations.fetch_add( 1, std::memory_order_relaxed );
+	counters.bytes.fetch_add( bytes, std::memory_order_relaxed );
+
+	if ( bytes < HUGE_PAGE_BYTES )
+	{
+		void *p = malloc( bytes );
+		if ( !p )
+			throw std::bad_alloc();
+		return p;
+	}
+	const size_t size = ( bytes + HUGE_PAGE_BYTES-1 ) & ~( HUGE_PAGE_BYTES-1 );
+
+#if defined( MAP_HUGETLB )
+	if ( ArenaHugePages().load( std::memory_order_relaxed ) )
+	{
+		void *p = mmap( nullptr, size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB, -1, 0 );
+		if ( p != MAP_FAILED )
+		{
+			counters.huge_tlb_allocations.fetch_add( 1, std::memory_order_relaxed );
+			return p;
+		}
+	}
+#endif
+
+	// A huge page has to start on a multiple of its size, so map a
+	// bit extra, and then unmap the bits before and after the part
+	// that lines up
+	char *p = (char *)mmap( nullptr, size + HUGE_PAGE_BYTES, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0 );
+	if ( p == (char *)MAP_FAILED )
+		throw std::bad_alloc();
+	char *aligned = (char *)( ( (uintptr_t)p + HUGE_PAGE_BYTES-1 ) & ~( HUGE_PAGE_BYTES-1 ) );
+	if ( aligned > p )
+		munmap( p, aligned - p );
+	munmap( aligned + size, p + HUGE_PAGE_BYTES - aligned );
+
+#if defined( MADV_HUGEPAGE )
+	madvise( aligned, size, MADV_HUGEPAGE );
+#endif
+	return aligned;
+}
+
+// Free a block allocated by AllocatePages
+inline void FreePages( void *p, size_t bytes )
+{
+	if ( !p )
+		return;
+	if ( bytes < HUGE_PAGE_BYTES )
+		free( p );
+	else
+		munmap( p, ( bytes + HUGE_PAGE_BYTES-1 ) & ~( HUGE_PAGE_BYTES-1 ) );
+}
+
+// A fixed-size array, allocated with AllocatePages.  This is for the
+// hash tables, which need all of their slots in one array.  The items
+// are not initialized (or destroyed), so they must be simple values.
+template <typename T>
+class PageArray
+{
+	static_assert( std::is_trivially_destructible<T>::value, "PageArray doesn't destroy its items" );
+public:
+	PageArray() {}
+	explicit PageArray( size_t count )
+	: m_items( (T *)AllocatePages( count*sizeof(T) ) ), m_count( count )
+	{
+	}
+	~PageArray()
+	{
+		FreePages( m_items, m_count*sizeof(T) );
+	}
+	PageArray( const PageArray & ) = delete;
+	PageArray &operator=( const PageArray & ) = delete;
+
+	T &operator[]( size_t idx ) { return m_items[idx]; }
+	const T &operator[]( size_t idx ) const { return m_items[idx]; }
+	size_t size() const { return m_count; }
+	bool empty() const { return m_count == 0; }
+	T *begin() { return m_items; }
+	T *end() { return m_items + m_count; }
+	const T *begin() const { return m_items; }
+	const T *end() const { return m_items + m_count; }
+
+	void swap( PageArray &x )
+	{
+		std::swap( m_items, x.m_items );
+		std::swap( m_count, x.m_count );
+	}
+
+private:
+	T *m_items = nullptr;
+	size_t m_count = 0;
+};
+
+// A list that only grows at the end, like a std::vector, but stored
+// in chunks of HUGE_PAGE_BYTES.  Growing never moves the items that
+// are already there, so it never needs more memory than the items
+// themselves (plus the last chunk), and never copies anything.
+//
+// Finding an item takes one extra step: the top bits of the index
+// pick the chunk, and the bottom bits pick the item in the chunk.
+// The number of items per chunk is a power of two, so that's just
+// a shift and a mask.
+//
+// clear() keeps the chunks for next time, so it takes no time at all,
+// and once the list has been as big as it's ever going to get, it
+// doesn't allocate again.
+template <typename T>
+class ChunkedVector
+{
+	static_assert( std::is_trivially_copyable<T>::value && std::is_trivially_destructible<T>::value,
+		"ChunkedVector doesn't construct or destroy its items" );
+public:
+	ChunkedVector() {}
+	~ChunkedVector()
+	{
+		for ( T *chunk: m_chunks )
+			FreePages( chunk, HUGE_PAGE_BYTES );
+	}
+	ChunkedVector( const ChunkedVector & ) = delete;
+	ChunkedVector &operator=( const ChunkedVector & ) = delete;
+
+	T &operator[]( size_t idx ) { return m_chunks[ idx >> CHUNK_SHIFT ][ idx & CHUNK_MASK ]; }
+	const T &operator[]( size_t idx ) const { return m_chunks[ idx >> CHUNK_SHIFT ][ idx & CHUNK_MASK ]; }
+	T &back() { return (*this)[ m_size-1 ]; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	void push_back( const T &x )
+	{
+		if ( m_size == m_chunks.size() << CHUNK_SHIFT )
+			m_chunks.push_back( (T *)AllocatePages( HUGE_PAGE_BYTES ) );
+		(*this)[ m_size++ ] = x;
+	}
+
+	// Allocate the chunks for this many items now.  (The OS doesn't
+	// give us the memory until we touch it, so this is cheap.)
+	void reserve( size_t count )
+	{
+		while ( count > m_chunks.size() << CHUNK_SHIFT )
+			m_chunks.push_back( (T *)AllocatePages( HUGE_PAGE_BYTES ) );
+	}
+
+	// Forget all of the items, but keep the chunks
+	void clear() { m_size = 0; }
+
+	void swap( ChunkedVector &x )
+	{
+		m_chunks.swap( x.m_chunks );
+		std::swap( m_size, x.m_size );
+	}
+
+private:
+
+	// Largest power of two items that fits in a chunk
+	static constexpr int ChunkShift()
+	{
+		int shift = 0;
+		while ( ( sizeof(T) << ( shift+1 ) ) <= HUGE_PAGE_BYTES )
+			++shift;
+		return shift;
+	}
+	static constexpr int CHUNK_SHIFT = ChunkShift();
+	static constexpr size_t CHUNK_MASK = ( size_t(1) << CHUNK_SHIFT ) - 1;
+
+	std::vector<T *> m_chunks;
+	size_t m_size = 0;
+};
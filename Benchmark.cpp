@@ -0,0 +1,463 @@
+//
+// Benchmarks for the Rush Hour solver.
+//
+// Build with:
+//
+//    g++ -O2 -pthread -o Benchmark Benchmark.cpp
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ConcurrentStateTable.h"
+#include "Solver.h"
+#include "ThreadPool.h"
+
+// Count every call to operator new, so we can see whether the solver
+// allocates memory after it has warmed up.  (This counts everything
+// that uses new or a standard container.  The big tables get their
+// memory from AllocatePages instead, which has its own counters.)
+static std::atomic<uint64_t> g_heap_allocations { 0 };
+
+void *operator new( size_t size )
+{
+	g_heap_allocations.fetch_add( 1, std::memory_order_relaxed );
+	if ( void *p = malloc( size ? size : 1 ) )
+		return p;
+	throw std::bad_alloc();
+}
+// (noinline, so GCC doesn't see free() next to a call to operator new
+// and warn that they don't match.)
+__attribute__((noinline)) void operator delete( void *p ) noexcept { free( p ); }
+__attribute__((noinline)) void operator delete( void *p, size_t ) noexcept { free( p ); }
+
+// Current time, in seconds
+static double Now()
+{
+	using namespace std::chrono;
+	return duration<double>( steady_clock::now().time_since_epoch() ).count();
+}
+
+// Key number i, scrambled so that the keys land all over
+// the table, like real packed states do.
+static uint64_t StressKey( uint64_t i )
+{
+	uint64_t key = HashMix64( i + 1 );
+	return key == ~0ull ? 0 : key;
+}
+
+// Hammer the visited state table from several threads at once,
+// and measure how the insert throughput scales with the number
+// of threads.
+//
+// We insert num_keys different keys, each one twice, split across
+// the threads so that each key is usually inserted by two different
+// threads, at different times.  That's roughly what the parallel
+// search does: most successor states are new, but a good fraction
+// are duplicates found from another parent.  Each insert uses a
+// different tag, and we check that exactly one insert of each key
+// won, and that the table kept the smallest tag.
+//
+// For comparison, we also run the same workload against a plain
+// HashSet protected by a single lock.
+static int StressTable( uint64_t num_keys, int max_threads )
+{
+	printf( "Visited table stress test: %llu keys, each inserted twice\n", (unsigned long long)num_keys );
+	printf( "%8s %14s %9s %14s %9s\n", "threads", "lock-free M/s", "speedup", "one-lock M/s", "overflow" );
+
+	// Work out which thread covers which keys.  Thread t inserts
+	// keys start_t, start_t+1, ... (wrapping around), 2*num_keys/T
+	// of them.  Together the threads cover every key exactly twice.
+	auto ThreadRange = [num_keys]( int t, int num_threads, uint64_t &start, uint64_t &count )
+	{
+		start = num_keys * t / num_threads;
+		count = num_keys * 2 * ( t+1 ) / num_threads - num_keys * 2 * t / num_threads;
+	};
+
+	// Try 1, 2, 4, ... threads, and finally max_threads
+	std::vector<int> thread_counts;
+	for ( int n = 1 ; n < max_threads ; n *= 2 )
+		thread_counts.push_back( n );
+	thread_counts.push_back( max_threads );
+
+	double single_thread_rate = 0.0;
+	for ( int num_threads: thread_counts )
+	{
+		ThreadPool pool( num_threads );
+
+		// Lock-free table
+		ConcurrentStateTable table;
+		table.Reserve( num_keys );
+		std::vector<uint64_t> wins( num_threads );
+		double start_time = Now();
+		pool.ParallelFor( num_threads, [&]( int t )
+		{
+			uint64_t start, count, won = 0;
+			ThreadRange( t, num_threads, start, count );
+			for ( uint64_t i = 0 ; i < count ; ++i )
+			{
+				uint64_t j = ( start + i ) % num_keys;
+				if ( table.InsertOrLowerTag( StressKey( j ), uint64_t(t) << 40 | i ) )
+					++won;
+			}
+			wins[t] = won;
+		} );
+		double lock_free_time = Now() - start_time;
+
+		// Check the results
+		uint64_t total_wins = 0;
+		for ( uint64_t w: wins )
+			total_wins += w;
+		if ( total_wins != num_keys || table.size() != num_keys )
+		{
+			fprintf( stderr, "FAILED: %llu inserts won, table has %llu keys, expected %llu\n",
+				(unsigned long long)total_wins, (unsigned long long)table.size(), (unsigned long long)num_keys );
+			return 1;
+		}
+		std::vector<uint64_t> expected_tag( num_keys, ~0ull );
+		for ( int t = 0 ; t < num_threads ; ++t )
+		{
+			uint64_t start, count;
+			ThreadRange( t, num_threads, start, count );
+			for ( uint64_t i = 0 ; i < count ; ++i )
+			{
+				uint64_t j = ( start + i ) % num_keys;
+				expected_tag[j] = std::min( expected_tag[j], uint64_t(t) << 40 | i );
+			}
+		}
+		for ( uint64_t j = 0 ; j < num_keys ; ++j )
+		{
+			if ( table.Tag( StressKey( j ) ) != expected_tag[j] )
+			{
+				fprintf( stderr, "FAILED: key %llu has the wrong tag\n", (unsigned long long)j );
+				return 1;
+			}
+		}
+
+		// Same thing, with one lock around an ordinary hash set
+		std::mutex lock;
+		HashSet<uint64_t> locked_set( num_keys );
+		start_time = Now();
+		pool.ParallelFor( num_threads, [&]( int t )
+		{
+			uint64_t start, count;
+			ThreadRange( t, num_threads, start, count );
+			for ( uint64_t i = 0 ; i < count ; ++i )
+			{
+				uint64_t j = ( start + i ) % num_keys;
+				std::lock_guard<std::mutex> guard( lock );
+				locked_set.Insert( StressKey( j ) );
+			}
+		} );
+		double locked_time = Now() - start_time;
+
+		double rate = num_keys*2 / lock_free_time / 1e6;
+		if ( num_threads == 1 )
+			single_thread_rate = rate;
+		printf( "%8d %14.1f %8.2fx %14.1f %9llu\n", num_threads, rate, rate / single_thread_rate,
+			num_keys*2 / locked_time / 1e6, (unsigned long long)table.OverflowInserts() );
+	}
+
+	return 0;
+}
+
+// The boards from the game that RushHourSolver.cpp has built in
+static const struct
+{
+	const char *name;
+	const char *board;
+} BUNDLED_BOARDS[] =
+{
+	{ "board1",   "AA...OP..Q.OPXXQ.OP..Q..B...CCB.RRR." },
+	{ "board93",  ".AAB.OCD.B.OCDXXEOFGGHE.F.IHJJ..IPPP" },
+	{ "board155", "OOOA.P..BA.PXXBIIP.DEEFFGDH.CCG.H.JJ" },
+};
+
+// The search engines we can compare.  IDA* re-explores the same
+// states many times over, and takes minutes on the corpus, so it
+// only runs if asked for by name.
+static const struct
+{
+	const char *name;
+	SearchAlgorithm algorithm;
+	bool parallel;
+	bool frontier_only;
+	bool run_by_default;
+} ENGINES[] =
+{
+	{ "bfs",           SearchAlgorithm::BreadthFirst,  false, false, true },
+	{ "bfs-parallel",  SearchAlgorithm::BreadthFirst,  true,  false, true },
+	{ "bfs-frontier",  SearchAlgorithm::BreadthFirst,  false, true,  true },
+	{ "bidirectional", SearchAlgorithm::Bidirectional, false, false, true },
+	{ "astar",         SearchAlgorithm::AStar,         false, false, true },
+	{ "idastar",       SearchAlgorithm::IDAStar,       false, false, false },
+};
+
+// A set of boards that we time together
+struct BenchmarkCase
+{
+	std::string name;
+	std::vector<Board> boards;
+};
+
+// Return the value at a percentile of a sorted list of times,
+// using the nearest rank
+static double Percentile( const std::vector<double> &sorted, double pct )
+{
+	size_t rank = (size_t)( pct / 100.0 * sorted.size() + 0.999999 );
+	rank = std::max( rank, size_t(1) );
+	return sorted[ std::min( rank, sorted.size() ) - 1 ];
+}
+
+// Time each search engine on each of the bundled boards, and on
+// the whole corpus of puzzles.
+//
+// Each engine gets one Solver, which is reused for all the runs, the
+// way a program that solves lots of puzzles would use it.  We solve
+// each set of boards once to warm up, then time it num_repeats
+// times, and report the fastest, median and 99th percentile times.
+// The search is deterministic, so the counts are the same every time.
+// (IDA* doesn't remember the states it discovers, so for IDA* we count
+// the states it expanded instead, which includes repeats.)
+// From those we work out the number of states discovered per second,
+// and the average time taken to generate and look up one move (one
+// call to CheckAddState, for the breadth-first search).  We also
+// report the peak memory of the process while running that case, and
+// how many times the solver had to allocate memory for its tables
+// during the timed runs (see Arena.h).  After the warm up, the tables
+// are already big enough, so that should be 0.
+//
+// With json set, we print one JSON object per line instead of a
+// table, so that results can be compared by a script.
+static int BenchmarkSolve( const std::vector<BenchmarkCase> &cases, const std::vector<int> &engines,
+	int num_repeats, int num_threads, bool json )
+{
+	if ( !json )
+	{
+		printf( "%-14s %-9s %6s %9s %10s %9s %9s %9s %10s %11s %9s %6s %10s\n", "engine", "case", "moves", "states", "generated",
+			"min ms", "med ms", "p99 ms", "states/s", "ns/generate", "peak KB", "blocks", "news/solve" );
+	}
+
+	for ( int idx_engine: engines )
+	{
+		SolverOptions options;
+		options.algorithm = ENGINES[idx_engine].algorithm;
+		options.num_threads = ENGINES[idx_engine].parallel ? num_threads : -1;
+		options.frontier_only = ENGINES[idx_engine].frontier_only;
+		Solver solver( options );
+
+		for ( const BenchmarkCase &c: cases )
+		{
+			ResetPeakMemory();
+
+			// Warm up, and collect the counts
+			int total_moves = 0;
+			uint64_t states_discovered = 0, states_generated = 0;
+			for ( const Board &board: c.boards )
+			{
+				SolveResult result = solver.Solve( board );
+				if ( result.status != SolveStatus::Solved )
+				{
+					fprintf( stderr, "FAILED: %s could not solve a board in %s\n", ENGINES[idx_engine].name, c.name.c_str() );
+					return 1;
+				}
+				total_moves += result.depth;
+				states_discovered += result.states_discovered ? result.states_discovered : result.states_expanded;
+				states_generated += result.states_generated;
+			}
+
+			std::vector<double> times;
+			times.reserve( num_repeats );
+			const uint64_t blocks_before = GetArenaCounters().allocations.load();
+			const uint64_t heap_before = g_heap_allocations.load();
+			for ( int r = 0 ; r < num_repeats ; ++r )
+			{
+				double start_time = Now();
+				for ( const Board &board: c.boards )
+					solver.Solve( board );
+				times.push_back( Now() - start_time );
+			}
+			// Blocks from AllocatePages, and calls to operator new per
+			// puzzle solved.  (Each solve allocates a few vectors for
+			// the solution it returns, so that one is never 0.)
+			const uint64_t blocks = GetArenaCounters().allocations.load() - blocks_before;
+			const double news_per_solve = double( g_heap_allocations.load() - heap_before ) / ( num_repeats * c.boards.size() );
+			std::sort( times.begin(), times.end() );
+			const double min_time = times.front();
+			const double median_time = Percentile( times, 50.0 );
+			const double p99_time = Percentile( times, 99.0 );
+			const double states_per_sec = states_discovered / median_time;
+			const double ns_per_generate = states_generated ? median_time * 1e9 / states_generated : 0.0;
+			const long peak_kb = PeakMemoryKB();
+
+			if ( json )
+			{
+				printf( "{\"engine\":\"%s\",\"case\":\"%s\",\"boards\":%d,\"repeats\":%d,\"moves\":%d,"
+					"\"states\":%llu,\"generated\":%llu,\"min_sec\":%.9f,\"median_sec\":%.9f,\"p99_sec\":%.9f,"
+					"\"states_per_sec\":%.0f,\"ns_per_generate\":%.2f,\"peak_kb\":%ld,\"arena_blocks\":%llu,\"news_per_solve\":%.1f}\n",
+					ENGINES[idx_engine].name, c.name.c_str(), (int)c.boards.size(), num_repeats, total_moves,
+					(unsigned long long)states_discovered, (unsigned long long)states_generated,
+					min_time, median_time, p99_time, states_per_sec, ns_per_generate, peak_kb, (unsigned long long)blocks, news_per_solve );
+			}
+			else
+			{
+				printf( "%-14s %-9s %6d %9llu %10llu %9.3f %9.3f %9.3f %10.0f %11.1f %9ld %6llu %10.1f\n",
+					ENGINES[idx_engine].name, c.name.c_str(), total_moves,
+					(unsigned long long)states_discovered, (unsigned long long)states_generated,
+					min_time*1e3, median_time*1e3, p99_time*1e3, states_per_sec, ns_per_generate, peak_kb, (unsigned long long)blocks, news_per_solve );
+			}
+			fflush( stdout );
+		}
+	}
+
+	return 0;
+}
+
+// Read a corpus of puzzles, in the format used by RushHourSolver --batch
+static bool LoadCorpus( const char *filename, BenchmarkCase &out )
+{
+	FILE *f = fopen( filename, "r" );
+	if ( !f )
+	{
+		fprintf( stderr, "Can't open %s\n", filename );
+		return false;
+	}
+	out.name = "corpus";
+	char line[256];
+	for ( int line_number = 1 ; fgets( line, sizeof(line), f ) ; ++line_number )
+	{
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+		if ( line[0] == '\0' || line[0] == '#' )
+			continue;
+		Board board;
+		if ( !board.Parse( line ) )
+		{
+			fprintf( stderr, "%s(%d): Can't parse board\n", filename, line_number );
+			fclose( f );
+			return false;
+		}
+		out.boards.push_back( board );
+	}
+	fclose( f );
+	return true;
+}
+
+static void PrintUsage( const char *argv0 )
+{
+	fprintf( stderr, "Usage: %s table [--keys N] [--max-threads N]\n", argv0 );
+	fprintf( stderr, "       %s solve [--engine NAME]... [--corpus FILE] [--repeat N] [--threads N] [--huge-pages] [--json]\n", argv0 );
+	fprintf( stderr, "  table   Stress test the lock-free visited state table\n" );
+	fprintf( stderr, "  solve   Time the search engines on the bundled boards and a corpus of puzzles\n" );
+	fprintf( stderr, "          Engines:" );
+	for ( const auto &engine: ENGINES )
+		fprintf( stderr, " %s%s", engine.name, engine.run_by_default ? "" : " (only if asked for)" );
+	fprintf( stderr, "\n" );
+}
+
+int main( int argc, char **argv )
+{
+	if ( argc < 2 )
+	{
+		PrintUsage( argv[0] );
+		return 1;
+	}
+
+	uint64_t num_keys = 1 << 22;
+	int max_threads = (int)std::thread::hardware_concurrency();
+	std::vector<int> engines;
+	const char *corpus_filename = "puzzles.txt";
+	int num_repeats = 10;
+	int num_threads = 0;
+	bool json = false;
+	for ( int i = 2 ; i < argc ; ++i )
+	{
+		if ( !strcmp( argv[i], "--keys" ) && i+1 < argc )
+			num_keys = strtoull( argv[++i], nullptr, 10 );
+		else if ( !strcmp( argv[i], "--max-threads" ) && i+1 < argc )
+			max_threads = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--engine" ) && i+1 < argc )
+		{
+			const char *name = argv[++i];
+			int found = -1;
+			for ( int e = 0 ; e < (int)( sizeof(ENGINES) / sizeof(ENGINES[0]) ) ; ++e )
+			{
+				if ( !strcmp( ENGINES[e].name, name ) )
+					found = e;
+			}
+			if ( found < 0 )
+			{
+				PrintUsage( argv[0] );
+				return 1;
+			}
+			engines.push_back( found );
+		}
+		else if ( !strcmp( argv[i], "--corpus" ) && i+1 < argc )
+			corpus_filename = argv[++i];
+		else if ( !strcmp( argv[i], "--repeat" ) && i+1 < argc )
+			num_repeats = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--threads" ) && i+1 < argc )
+			num_threads = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--json" ) )
+			json = true;
+		else if ( !strcmp( argv[i], "--huge-pages" ) )
+			ArenaHugePages() = true;
+		else
+		{
+			PrintUsage( argv[0] );
+			return 1;
+		}
+	}
+	if ( max_threads < 1 )
+		max_threads = 1;
+	if ( num_keys < 1 )
+		num_keys = 1;
+	if ( num_repeats < 1 )
+		num_repeats = 1;
+	if ( num_threads < 0 )
+		num_threads = 0;
+
+	if ( !strcmp( argv[1], "table" ) )
+		return StressTable( num_keys, max_threads );
+
+	if ( !strcmp( argv[1], "solve" ) )
+	{
+		std::vector<BenchmarkCase> cases;
+		for ( const auto &bundled: BUNDLED_BOARDS )
+		{
+			BenchmarkCase c;
+			c.name = bundled.name;
+			c.boards.resize( 1 );
+			c.boards[0].Parse( bundled.board );
+			cases.push_back( c );
+		}
+		BenchmarkCase corpus;
+		if ( !LoadCorpus( corpus_filename, corpus ) )
+			return 1;
+		cases.push_back( corpus );
+
+		if ( engines.empty() )
+		{
+			for ( int e = 0 ; e < (int)( sizeof(ENGINES) / sizeof(ENGINES[0]) ) ; ++e )
+			{
+				if ( ENGINES[e].run_by_default )
+					engines.push_back( e );
+			}
+		}
+		return BenchmarkSolve( cases, engines, num_repeats, num_threads, json );
+	}
+
+	PrintUsage( argv[0] );
+	return 1;
+}
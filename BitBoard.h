@@ -0,0 +1,755 @@
+//
+// Bitboard representation of a Rush Hour board.
+//
+// The grid of characters in Board is easy to read and print, but
+// slow to search with, since finding the possible moves means
+// visiting every cell.  Here, each cell of the board is instead
+// assigned one bit of a 64-bit integer.  A set of cells (such as
+// the cells covered by a car, or all the occupied cells) is then
+// just an integer, and we can move a car one square by shifting
+// its mask, and check for a collision with a single AND.
+//
+// We don't even store the masks.  Since a vehicle can only slide
+// back and forth along its own row or column, the only thing
+// about it that changes during the search is how far along that
+// track it is.  So a board state is "packed" into a single
+// integer, with a few bits for the position of each vehicle.  The
+// masks are recomputed from the packed state when we need them.
+//
+
+#pragma once
+
+#include <stdarg.h>
+
+#include <algorithm>
+#include <string>
+#include <type_traits>
+
+#if defined( __AVX2__ )
+	#include <immintrin.h>
+#endif
+
+#include "Board.h"
+
+// Each vehicle's position is stored in 4 bits of the packed state.
+// The value is the offset of the vehicle along its track, in
+// squares, from the left or top of the board.  A special value
+// marks a vehicle that has driven off the board.
+constexpr int OFFSET_BITS = 4;
+constexpr int OFFSET_EXITED = ( 1 << OFFSET_BITS ) - 1;
+
+// How we count moves.  The solver normally moves a vehicle one
+// square at a time, so sliding a car three squares counts as three
+// moves.  The cards that come with the game count that as one move.
+enum class MoveMetric
+{
+	// Each move slides one vehicle one square
+	Square,
+
+	// Each move slides one vehicle any number of squares
+	Slide,
+};
+
+// A packed state, and its index in a list of states.  Used
+// to look up where in a list a state is.  Only the state is
+// used for hashing and comparison.
+template <typename TState>
+struct IndexedStateT
+{
+	TState state;
+	int index;
+	bool operator==( const IndexedStateT &x ) const { return state == x.state; }
+};
+template <typename TState>
+struct HashSetTraits< IndexedStateT<TState> >
+{
+	static uint64_t Hash( const IndexedStateT<TState> &s ) { return HashSetTraits<TState>::Hash( s.state ); }
+	static bool IsEmpty( const IndexedStateT<TState> &s ) { return HashSetTraits<TState>::IsEmpty( s.state ); }
+	static IndexedStateT<TState> Empty() { return IndexedStateT<TState>{ HashSetTraits<TState>::Empty(), -1 }; }
+};
+
+// Index of the lowest bit that is set, which must not be zero
+inline int LowestSetBit( uint64_t x )
+{
+	return __builtin_ctzll( x );
+}
+inline int LowestSetBit( uint128_t x )
+{
+	return uint64_t( x ) ? __builtin_ctzll( uint64_t( x ) ) : 64 + __builtin_ctzll( uint64_t( x >> 64 ) );
+}
+
+// Information about a vehicle that doesn't change during the
+// search.  Cars can only move forward and backward, so the
+// orientation, length, and track (row or column) are fixed.
+struct Vehicle
+{
+	// Character used to identify this vehicle in the Board grid
+	char label;
+
+	// Which way does it move?
+	bool horizontal;
+
+	// Number of cells it covers.  A vehicle of length 1 has no
+	// orientation, and cannot move.
+	int length;
+
+	// True if this vehicle can drive off the board through the
+	// exit, to get out of the way.  This is true for any
+	// horizontal vehicle in the exit row, other than the goal car.
+	bool can_exit;
+
+	// Mask of the cells covered when the vehicle is at offset 0,
+	// as far left or up as it can go.
+	uint64_t base_mask;
+
+	// How many bits to shift the mask to move one square along
+	// the track.  1 for horizontal, the width of the board for vertical.
+	int stride;
+
+	// Largest offset, where the vehicle touches the right or
+	// bottom edge of the board.
+	int max_offset;
+
+	// Return the mask of cells covered at the given offset
+	uint64_t Mask( int offset ) const
+	{
+		if ( offset == OFFSET_EXITED )
+			return 0;
+		return base_mask << ( offset*stride );
+	}
+};
+
+// Table of the vehicles on the board.  This is computed once from
+// the initial board, and then used to interpret packed states
+// and generate moves.
+//
+// This is also where everything that depends on the size of the
+// board lives.  The size is a template parameter, so it's a constant
+// in all of the code that generates moves, and there's no need to
+// check it at run time.
+template <typename TGeometry>
+struct VehicleTableT
+{
+	typedef BoardT<TGeometry> Board;
+	static constexpr int WIDTH = TGeometry::WIDTH;
+	static constexpr int HEIGHT = TGeometry::HEIGHT;
+	static constexpr int EXIT_Y = TGeometry::EXIT_Y;
+
+	// Cell (y,x) is bit number y*WIDTH + x.  So bit 0 is the
+	// top left corner, moving right one square is a shift left by
+	// one bit, and moving down one square is a shift left by
+	// WIDTH bits.
+	static constexpr int CELLS = TGeometry::CELLS;
+	static_assert( CELLS <= 64, "Board must fit in a 64-bit mask" );
+
+	// Return the mask for a single cell
+	static constexpr uint64_t CellBit( int y, int x )
+	{
+		return 1ull << ( y*WIDTH + x );
+	}
+
+	// Return the mask for all of the cells in a column
+	static constexpr uint64_t ColumnMask( int x )
+	{
+		uint64_t m = 0;
+		for ( int y = 0 ; y < HEIGHT ; ++y )
+			m |= CellBit( y, x );
+		return m;
+	}
+
+	// Return the mask for all of the cells in a row
+	static constexpr uint64_t RowMask( int y )
+	{
+		uint64_t m = 0;
+		for ( int x = 0 ; x < WIDTH ; ++x )
+			m |= CellBit( y, x );
+		return m;
+	}
+
+	// The largest number of vehicles we support on the board.  The
+	// game comes with 16 (including the goal car), and at 4 bits each,
+	// 16 vehicles fit in a 64-bit packed state.  There's room for a lot
+	// more on an 8x8 board, so there we allow 32, in 128 bits.
+	static constexpr int MAX_VEHICLES = CELLS > 49 ? 32 : 16;
+	typedef typename std::conditional< MAX_VEHICLES*OFFSET_BITS <= 64, uint64_t, uint128_t >::type PackedState;
+	typedef IndexedStateT<PackedState> IndexedState;
+	static_assert( MAX_VEHICLES*OFFSET_BITS <= (int)sizeof(PackedState)*8, "Packed state must hold every vehicle" );
+	static_assert( WIDTH < OFFSET_EXITED && HEIGHT < OFFSET_EXITED, "Offsets must fit in OFFSET_BITS" );
+
+	// Most moves that can be made from any one state.  In the slide
+	// metric, each vehicle can move to any of the other positions along
+	// its track, and a vehicle of length 2 has WIDTH-1 (or HEIGHT-1)
+	// positions.
+	static constexpr int MAX_MOVES_PER_STATE = MAX_VEHICLES*( std::max( WIDTH, HEIGHT ) - 2 );
+
+	int count = 0;
+
+	// Index of the goal car 'X'
+	int goal = -1;
+
+	// Mask of the wall cells.  These never move, so they aren't
+	// vehicles, and aren't in the packed state at all.  They are
+	// just already there in the mask of occupied cells, before we
+	// add any vehicles, so they cost nothing when we look for moves.
+	uint64_t walls = 0;
+
+	Vehicle vehicle[MAX_VEHICLES];
+
+	// How moves are counted by ForEachMove and ForEachReverseMove.
+	// Init() doesn't change this.
+	MoveMetric metric = MoveMetric::Square;
+
+	// Some of the same information, as arrays with one entry per
+	// vehicle, so that the AVX2 version of ForEachMove can load four
+	// vehicles at a time into a register.  Unused entries are zero, which
+	// makes them look like vehicles that can't move.  Filled in by
+	// PrepareLanes().
+	uint64_t lane_base_mask[MAX_VEHICLES];
+	uint64_t lane_stride[MAX_VEHICLES];
+	uint64_t lane_max_offset[MAX_VEHICLES];
+
+	// Fill in the lane_xxx arrays from the vehicles.  Init() calls this.
+	// If you fill in the vehicles some other way, call it yourself.
+	void PrepareLanes()
+	{
+		for ( int v = 0 ; v < MAX_VEHICLES ; ++v )
+		{
+			lane_base_mask[v] = v < count ? vehicle[v].base_mask : 0;
+			lane_stride[v] = v < count ? vehicle[v].stride : 0;
+			lane_max_offset[v] = v < count ? vehicle[v].max_offset : 0;
+		}
+	}
+
+	// Get the offset of a vehicle from a packed state
+	static int Offset( PackedState state, int v )
+	{
+		return int( state >> ( v*OFFSET_BITS ) ) & OFFSET_EXITED;
+	}
+
+	// Check if any vehicle has exited
+	static bool HasExitedVehicle( PackedState state )
+	{
+		// OFFSET_EXITED is all ones, so look for 4 bits in a row.
+		// Dividing all ones by 0xf gives 0x1111..., with one bit
+		// for each vehicle, whatever the size of the state.
+		const PackedState all_ones = state & ( state >> 1 ) & ( state >> 2 ) & ( state >> 3 );
+		return ( all_ones & ( ~PackedState(0) / OFFSET_EXITED ) ) != 0;
+	}
+
+	// Amount to add to a packed state to move a vehicle one square
+	// forward (right or down)
+	static PackedState Step( int v )
+	{
+		return PackedState(1) << ( v*OFFSET_BITS );
+	}
+
+	// A move can be described in one byte: which vehicle moved, and
+	// where it was before.  Given the state after the move, that's
+	// enough to work out the state before it, however far the vehicle
+	// moved, and even if it drove off the board.  NO_MOVE is used for
+	// a state that wasn't reached by a move, like the initial state.
+	// (A vehicle is never at OFFSET_EXITED before it moves, so this
+	// can't be a real move.)
+	//
+	// The vehicle number takes the top 5 bits, and the offset the
+	// bottom 3.  That's enough, since on a board up to 8 squares
+	// across, the offset is never more than 6.  So NO_MOVE, which
+	// would be vehicle 31 at offset 7, can't be a real move, either.
+	static constexpr uint8_t NO_MOVE = 0xff;
+	static constexpr int MOVE_OFFSET_BITS = 3;
+	static_assert( MAX_VEHICLES <= ( 1 << ( 8-MOVE_OFFSET_BITS ) ), "Vehicle number must fit in a move code" );
+	static_assert( WIDTH-2 < ( 1 << MOVE_OFFSET_BITS )-1 && HEIGHT-2 < ( 1 << MOVE_OFFSET_BITS )-1, "Offset must fit in a move code" );
+
+	// Get the code for the move between two states, which must be
+	// one move apart
+	static uint8_t MoveCode( PackedState from, PackedState to )
+	{
+		const int v = LowestSetBit( from ^ to ) / OFFSET_BITS;
+		return uint8_t( ( v << MOVE_OFFSET_BITS ) | Offset( from, v ) );
+	}
+
+	// Undo a move, to get the state before it
+	static PackedState UndoMove( PackedState to, uint8_t move_code )
+	{
+		const int shift = ( move_code >> MOVE_OFFSET_BITS ) * OFFSET_BITS;
+		const PackedState offset = move_code & ( ( 1 << MOVE_OFFSET_BITS ) - 1 );
+		return ( to & ~( PackedState( OFFSET_EXITED ) << shift ) ) | ( offset << shift );
+	}
+
+	// Get the mask of cells covered by a vehicle in a packed state
+	uint64_t VehicleMask( PackedState state, int v ) const
+	{
+		return vehicle[v].Mask( Offset( state, v ) );
+	}
+
+	// Get the mask of all cells covered by any vehicle, or a wall
+	uint64_t Occupied( PackedState state ) const
+	{
+		uint64_t occupied = walls;
+		for ( int v = 0 ; v < count ; ++v )
+			occupied |= VehicleMask( state, v );
+		return occupied;
+	}
+
+	// Find all the vehicles on a Board, and fill in the table.
+	// Also returns the packed form of the same board state.
+	// Returns false if the board is not valid.  The reason is stored
+	// in out_error, or printed to stderr if out_error is null.
+	bool Init( const Board &board, PackedState &out_state, std::string *out_error = nullptr )
+	{
+		count = 0;
+		goal = -1;
+		walls = 0;
+		out_state = 0;
+
+		// Scan the grid and gather up the cells that each
+		// vehicle covers, assigning vehicle indices in the
+		// order that we first encounter them.
+		uint64_t masks[MAX_VEHICLES] = {};
+		for ( int y = 0 ; y < HEIGHT ; ++y )
+		{
+			for ( int x = 0 ; x < WIDTH ; ++x )
+			{
+				char c = board.Cell( y, x );
+				if ( c == ' ' )
+					continue;
+				if ( c == WALL_CELL )
+				{
+					walls |= CellBit( y, x );
+					continue;
+				}
+				int v = Find( c );
+				if ( v < 0 )
+				{
+					if ( count >= MAX_VEHICLES )
+					{
+						return InitFailed( out_error, "Too many vehicles on the board (max %d)", MAX_VEHICLES );
+					}
+					v = count++;
+					vehicle[v].label = c;
+					if ( c == 'X' )
+						goal = v;
+				}
+				masks[v] |= CellBit( y, x );
+			}
+		}
+
+		if ( goal < 0 )
+		{
+			return InitFailed( out_error, "Board does not contain the goal car 'X'" );
+		}
+
+		// Now check that each vehicle is a straight line of
+		// cells, and figure out which way it is facing
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			Vehicle &veh = vehicle[v];
+			const uint64_t m = masks[v];
+			veh.length = __builtin_popcountll( m );
+
+			// Starting from the top left cell, we must be able
+			// to reach every cell by moving right, or by moving down.
+			const int first = __builtin_ctzll( m );
+			const int y = first / WIDTH;
+			const int x = first % WIDTH;
+			const uint64_t row = veh.length > WIDTH ? 0 : RowMask( y ) & ( ( ( 1ull << veh.length ) - 1 ) << first );
+			uint64_t col = 0;
+			for ( int i = 0 ; i < veh.length && first + i*WIDTH < CELLS ; ++i )
+				col |= 1ull << ( first + i*WIDTH );
+			int offset;
+			if ( veh.length == 1 )
+			{
+				// Can't move, so just treat it as a track of length 1
+				veh.horizontal = true;
+				veh.stride = 1;
+				veh.max_offset = 0;
+				veh.base_mask = m;
+				offset = 0;
+			}
+			else if ( m == row )
+			{
+				veh.horizontal = true;
+				veh.stride = 1;
+				veh.max_offset = WIDTH - veh.length;
+				veh.base_mask = m >> x;
+				offset = x;
+			}
+			else if ( m == col )
+			{
+				veh.horizontal = false;
+				veh.stride = WIDTH;
+				veh.max_offset = HEIGHT - veh.length;
+				veh.base_mask = m >> ( y*WIDTH );
+				offset = y;
+			}
+			else
+			{
+				return InitFailed( out_error, "Vehicle '%c' is not a straight line", veh.label );
+			}
+
+			veh.can_exit = veh.horizontal && veh.length > 1 && v != goal && y == EXIT_Y;
+			out_state |= PackedState( offset ) << ( v*OFFSET_BITS );
+		}
+
+		if ( !vehicle[goal].horizontal || vehicle[goal].length < 2 || !( masks[goal] & RowMask( EXIT_Y ) ) )
+		{
+			return InitFailed( out_error, "Goal car 'X' must be horizontal, in the exit row" );
+		}
+
+		PrepareLanes();
+		return true;
+	}
+
+	// Report a problem found by Init.  Always returns false.
+	static bool InitFailed( std::string *out_error, const char *format, ... )
+	{
+		char message[128];
+		va_list args;
+		va_start( args, format );
+		vsnprintf( message, sizeof(message), format, args );
+		va_end( args );
+		if ( out_error )
+			*out_error = message;
+		else
+			fprintf( stderr, "%s\n", message );
+		return false;
+	}
+
+	// Return the index of the vehicle with the given label, or -1
+	int Find( char label ) const
+	{
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			if ( vehicle[v].label == label )
+				return v;
+		}
+		return -1;
+	}
+
+	// Convert a packed state back to the grid form, so we can print it
+	void ToBoard( PackedState state, Board &out ) const
+	{
+		memset( out.cell, ' ', sizeof(out.cell) );
+		for ( int y = 0 ; y < HEIGHT ; ++y )
+		{
+			for ( int x = 0 ; x < WIDTH ; ++x )
+			{
+				if ( walls & CellBit( y, x ) )
+					out.SetCell( y, x, WALL_CELL );
+			}
+		}
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			const uint64_t m = VehicleMask( state, v );
+			for ( int y = 0 ; y < HEIGHT ; ++y )
+			{
+				for ( int x = 0 ; x < WIDTH ; ++x )
+				{
+					if ( m & CellBit( y, x ) )
+						out.SetCell( y, x, vehicle[v].label );
+				}
+			}
+		}
+	}
+
+	// Has the goal car reached the exit?
+	bool IsSolved( PackedState state ) const
+	{
+		return Offset( state, goal ) == vehicle[goal].max_offset;
+	}
+
+	// Call fn( next_state ) for each state that can be reached from
+	// this state by moving one vehicle one square.
+	//
+	// Compare this to scanning the grid for empty cells: here, we
+	// visit each vehicle once, and each possible move is just a
+	// couple of shifts and masks.  The new state is made by adding
+	// or subtracting one from the vehicle's offset.
+	template <typename F>
+	inline void ForEachMove( PackedState state, F &&fn ) const
+	{
+		if ( metric == MoveMetric::Slide )
+		{
+			ForEachSlide( state, fn );
+			return;
+		}
+
+	#if defined( __AVX2__ )
+
+		// Check all the vehicles at once, then go through the ones
+		// that can move in order, so that we generate the moves in
+		// the same order as the plain version below.  (Only for a
+		// 64-bit packed state, which fits in one lane of a register.)
+		if constexpr ( sizeof(PackedState) == sizeof(uint64_t) )
+		{
+			uint32_t back, fwd;
+			FindMovableVehicles( state, back, fwd );
+			for ( uint32_t movable = back | fwd ; movable ; movable &= movable-1 )
+			{
+				const int v = __builtin_ctz( movable );
+				const int offset = Offset( state, v );
+				if ( back & ( 1u << v ) )
+					fn( state - Step( v ) );
+				if ( fwd & ( 1u << v ) )
+				{
+					if ( vehicle[v].can_exit && offset+1 == vehicle[v].max_offset )
+						fn( state + ( OFFSET_EXITED - offset ) * Step( v ) );
+					else
+						fn( state + Step( v ) );
+				}
+			}
+			return;
+		}
+
+	#endif
+
+		const uint64_t occupied = Occupied( state );
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			const Vehicle &veh = vehicle[v];
+			const int offset = Offset( state, v );
+
+			// Skip vehicles that have left the board
+			if ( offset == OFFSET_EXITED )
+				continue;
+
+			// Get the masks we would get by shifting the vehicle
+			// one square backward or forward along its track.
+			// Checking the offset first makes sure the vehicle
+			// isn't already touching the edge.  (Otherwise the
+			// shift would wrap around to the next row, or fall off
+			// the board.)  Then we check whether the single newly
+			// covered cell is empty, with an AND-NOT.
+			const uint64_t m = veh.Mask( offset );
+			const uint64_t back = m >> veh.stride;
+			const uint64_t fwd = m << veh.stride;
+			if ( offset > 0 && !( back & ~m & occupied ) )
+				fn( state - Step( v ) );
+			if ( offset < veh.max_offset && !( fwd & ~m & occupied ) )
+			{
+				// A vehicle that drives up to the exit (other
+				// than the goal car) continues right off the board.
+				if ( veh.can_exit && offset+1 == veh.max_offset )
+					fn( state + ( OFFSET_EXITED - offset ) * Step( v ) );
+				else
+					fn( state + Step( v ) );
+			}
+		}
+	}
+
+#if defined( __AVX2__ )
+
+	// Find which vehicles can move one square backward (left or up),
+	// and which can move one square forward (right or down).  Bit v of
+	// out_back and out_fwd is set if vehicle v can move that way.
+	//
+	// This does exactly the same checks as the plain version of
+	// ForEachMove, but for four vehicles at once, one in each 64-bit
+	// lane of a register.  AVX2 can shift each lane by a different
+	// amount, which is what makes this work.  (SSE can only shift all
+	// of the lanes by the same amount, and each vehicle needs its own.)
+	inline void FindMovableVehicles( PackedState state, uint32_t &out_back, uint32_t &out_fwd ) const
+	{
+		out_back = out_fwd = 0;
+		const int groups = ( count+3 ) / 4;
+		const __m256i zero = _mm256_setzero_si256();
+		const __m256i exited_offset = _mm256_set1_epi64x( OFFSET_EXITED );
+		const __m256i state_lanes = _mm256_set1_epi64x( (long long)state );
+		__m256i offset[MAX_VEHICLES/4], mask[MAX_VEHICLES/4], exited[MAX_VEHICLES/4];
+		__m256i occupied = _mm256_set1_epi64x( (long long)walls );
+		for ( int g = 0 ; g < groups ; ++g )
+		{
+			const __m256i shift = _mm256_setr_epi64x( g*16, g*16+4, g*16+8, g*16+12 );
+			offset[g] = _mm256_and_si256( _mm256_srlv_epi64( state_lanes, shift ), exited_offset );
+			exited[g] = _mm256_cmpeq_epi64( offset[g], exited_offset );
+			const __m256i stride = _mm256_loadu_si256( (const __m256i *)&lane_stride[g*4] );
+			const __m256i base_mask = _mm256_loadu_si256( (const __m256i *)&lane_base_mask[g*4] );
+			mask[g] = _mm256_andnot_si256( exited[g], _mm256_sllv_epi64( base_mask, _mm256_mul_epu32( offset[g], stride ) ) );
+			occupied = _mm256_or_si256( occupied, mask[g] );
+		}
+
+		// OR the four lanes together, and copy the result to all of them
+		__m128i o = _mm_or_si128( _mm256_castsi256_si128( occupied ), _mm256_extracti128_si256( occupied, 1 ) );
+		o = _mm_or_si128( o, _mm_unpackhi_epi64( o, o ) );
+		occupied = _mm256_broadcastq_epi64( o );
+
+		for ( int g = 0 ; g < groups ; ++g )
+		{
+			const __m256i stride = _mm256_loadu_si256( (const __m256i *)&lane_stride[g*4] );
+			const __m256i max_offset = _mm256_loadu_si256( (const __m256i *)&lane_max_offset[g*4] );
+			const __m256i back = _mm256_srlv_epi64( mask[g], stride );
+			const __m256i fwd = _mm256_sllv_epi64( mask[g], stride );
+			const __m256i back_clear = _mm256_cmpeq_epi64( _mm256_and_si256( _mm256_andnot_si256( mask[g], back ), occupied ), zero );
+			const __m256i fwd_clear = _mm256_cmpeq_epi64( _mm256_and_si256( _mm256_andnot_si256( mask[g], fwd ), occupied ), zero );
+			const __m256i can_back = _mm256_andnot_si256( exited[g], _mm256_and_si256( back_clear, _mm256_cmpgt_epi64( offset[g], zero ) ) );
+			const __m256i can_fwd = _mm256_and_si256( fwd_clear, _mm256_cmpgt_epi64( max_offset, offset[g] ) );
+			out_back |= uint32_t( _mm256_movemask_pd( _mm256_castsi256_pd( can_back ) ) ) << ( g*4 );
+			out_fwd |= uint32_t( _mm256_movemask_pd( _mm256_castsi256_pd( can_fwd ) ) ) << ( g*4 );
+		}
+	}
+
+#endif
+
+	// Call fn( prev_state ) for each state from which a single move
+	// leads to this state.  This is what we need to search backwards
+	// from the goal.  Sliding a vehicle can always be undone by sliding
+	// it back, so this is almost the same as ForEachMove.  The
+	// difference is the exit.  A vehicle that has driven off the board
+	// must have come from the square before the last one.  And a
+	// vehicle that can exit never stops in the last square, so it
+	// can't have just moved there.
+	template <typename F>
+	inline void ForEachReverseMove( PackedState state, F &&fn ) const
+	{
+		if ( metric == MoveMetric::Slide )
+		{
+			ForEachReverseSlide( state, fn );
+			return;
+		}
+
+		const uint64_t occupied = Occupied( state );
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			const Vehicle &veh = vehicle[v];
+			const int offset = Offset( state, v );
+			if ( offset == OFFSET_EXITED )
+			{
+				// Put it back where it drove off from.  The square it
+				// moved into on the way out must also be clear.
+				const uint64_t path = veh.Mask( veh.max_offset-1 ) | veh.Mask( veh.max_offset );
+				if ( !( path & occupied ) )
+					fn( state - ( OFFSET_EXITED - ( veh.max_offset-1 ) ) * Step( v ) );
+				continue;
+			}
+
+			const uint64_t m = veh.Mask( offset );
+			const uint64_t back = m >> veh.stride;
+			const uint64_t fwd = m << veh.stride;
+			if ( offset > 0 && !( back & ~m & occupied ) && !( veh.can_exit && offset == veh.max_offset ) )
+				fn( state - Step( v ) );
+			if ( offset < veh.max_offset && !( fwd & ~m & occupied ) )
+				fn( state + Step( v ) );
+		}
+	}
+
+	// ForEachMove for the slide metric.  Each vehicle can move any
+	// number of squares, as long as all the squares it passes through
+	// are empty.  We try each vehicle in turn, first the slides back,
+	// one square, two squares, and so on, until we hit something, and
+	// then the same going forward.
+	template <typename F>
+	inline void ForEachSlide( PackedState state, F &fn ) const
+	{
+		const uint64_t occupied = Occupied( state );
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			const Vehicle &veh = vehicle[v];
+			const int offset = Offset( state, v );
+			if ( offset == OFFSET_EXITED )
+				continue;
+
+			// Cells the vehicle could cover: anything that is empty,
+			// or covered by the vehicle itself
+			const uint64_t open = ~occupied | veh.Mask( offset );
+			for ( int o = offset-1 ; o >= 0 && !( veh.Mask( o ) & ~open ) ; --o )
+				fn( state - ( offset-o ) * Step( v ) );
+			for ( int o = offset+1 ; o <= veh.max_offset && !( veh.Mask( o ) & ~open ) ; ++o )
+			{
+				// Driving up to the exit takes it off the board
+				if ( veh.can_exit && o == veh.max_offset )
+				{
+					fn( state + ( OFFSET_EXITED - offset ) * Step( v ) );
+					break;
+				}
+				fn( state + ( o-offset ) * Step( v ) );
+			}
+		}
+	}
+
+	// ForEachReverseMove for the slide metric.  A slide can be undone
+	// by sliding back, except when a vehicle drives off the board.  It
+	// could have come from anywhere along the exit row that has a clear
+	// path to the exit.  A vehicle that can exit never stops in the last
+	// square, so if it's there now, it can't have just moved there.
+	// (It can only be there if it started there.)
+	template <typename F>
+	inline void ForEachReverseSlide( PackedState state, F &fn ) const
+	{
+		const uint64_t occupied = Occupied( state );
+		for ( int v = 0 ; v < count ; ++v )
+		{
+			const Vehicle &veh = vehicle[v];
+			const int offset = Offset( state, v );
+			if ( offset == OFFSET_EXITED )
+			{
+				uint64_t path = veh.Mask( veh.max_offset );
+				for ( int o = veh.max_offset-1 ; o >= 0 ; --o )
+				{
+					path |= veh.Mask( o );
+					if ( path & occupied )
+						break;
+					fn( state - ( OFFSET_EXITED - o ) * Step( v ) );
+				}
+				continue;
+			}
+			if ( veh.can_exit && offset == veh.max_offset )
+				continue;
+
+			const uint64_t open = ~occupied | veh.Mask( offset );
+			for ( int o = offset-1 ; o >= 0 && !( veh.Mask( o ) & ~open ) ; --o )
+				fn( state - ( offset-o ) * Step( v ) );
+			for ( int o = offset+1 ; o <= veh.max_offset && !( veh.Mask( o ) & ~open ) ; ++o )
+				fn( state + ( o-offset ) * Step( v ) );
+		}
+	}
+
+	// Call fn( state ) for every solved state with the same vehicles:
+	// the goal car is at the exit, and every other vehicle is anywhere
+	// along its track that it fits (or gone, if it can exit).
+	template <typename F>
+	void ForEachSolvedState( F &&fn ) const
+	{
+		const int offset = vehicle[goal].max_offset;
+		EnumerateSolvedStates( 0, PackedState( offset ) << ( goal*OFFSET_BITS ), walls | vehicle[goal].Mask( offset ), fn );
+	}
+
+private:
+
+	// Recursive helper for ForEachSolvedState.  Vehicles before v have
+	// already been placed.
+	template <typename F>
+	void EnumerateSolvedStates( int v, PackedState state, uint64_t occupied, F &fn ) const
+	{
+		if ( v == count )
+		{
+			fn( state );
+			return;
+		}
+		if ( v == goal )
+		{
+			EnumerateSolvedStates( v+1, state, occupied, fn );
+			return;
+		}
+		const Vehicle &veh = vehicle[v];
+		for ( int offset = 0 ; offset <= veh.max_offset ; ++offset )
+		{
+			const uint64_t m = veh.Mask( offset );
+			if ( !( m & occupied ) )
+				EnumerateSolvedStates( v+1, state | PackedState( offset ) << ( v*OFFSET_BITS ), occupied | m, fn );
+		}
+		if ( veh.can_exit )
+			EnumerateSolvedStates( v+1, state | PackedState( OFFSET_EXITED ) << ( v*OFFSET_BITS ), occupied, fn );
+	}
+};
+
+// The standard board
+typedef VehicleTableT<StandardGeometry> VehicleTable;
+typedef VehicleTable::PackedState PackedState;
+typedef VehicleTable::IndexedState IndexedState;
+constexpr int BOARD_CELLS = VehicleTable::CELLS;
+constexpr int MAX_VEHICLES = VehicleTable::MAX_VEHICLES;
+constexpr int MAX_MOVES_PER_STATE = VehicleTable::MAX_MOVES_PER_STATE;
+
+constexpr uint64_t CellBit( int y, int x ) { return VehicleTable::CellBit( y, x ); }
+constexpr uint64_t ColumnMask( int x ) { return VehicleTable::ColumnMask( x ); }
+constexpr uint64_t RowMask( int y ) { return VehicleTable::RowMask( y ); }
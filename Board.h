@@ -0,0 +1,270 @@
+//
+// Simple grid representation of a Rush Hour board.  This
+// is the format we use for input and for printing.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "HashSet.h"
+
+// The size of the board, and the row with the exit.  Cars can exit
+// the board by moving off to the right on that row.
+//
+// Everything that depends on the size of the board is a template
+// that takes one of these, so the compiler knows the size, and can
+// unroll the loops over the cells and pick the right size of
+// integer for a packed state (see BitBoard.h).  We make a copy of
+// the solver for each size we support, and pick one at run time.
+template <int WIDTH_, int HEIGHT_, int EXIT_Y_>
+struct BoardGeometry
+{
+	static constexpr int WIDTH = WIDTH_;
+	static constexpr int HEIGHT = HEIGHT_;
+	static constexpr int EXIT_Y = EXIT_Y_;
+	static constexpr int CELLS = WIDTH*HEIGHT;
+	static_assert( EXIT_Y >= 0 && EXIT_Y < HEIGHT, "Exit must be on the board" );
+};
+
+// The rush bour board is 6x6, and the exit is on the 3rd row
+// (index 2).  There are also 7x7 and 8x8 versions, with the exit
+// on the middle row, or just above the middle.
+typedef BoardGeometry<6,6,2> Geometry6x6;
+typedef BoardGeometry<7,7,3> Geometry7x7;
+typedef BoardGeometry<8,8,3> Geometry8x8;
+
+// Most of the code (distance tables, the solution cache, the
+// generator) only works with the standard board.  These are
+// for that.
+typedef Geometry6x6 StandardGeometry;
+constexpr int BOARD_SIZE = StandardGeometry::WIDTH;
+constexpr int BOARD_EXIT_Y = StandardGeometry::EXIT_Y;
+
+// A wall: a cell that nothing can ever move into.  (A lowercase 'x',
+// so it doesn't get mixed up with the goal car 'X'.)
+constexpr char WALL_CELL = 'x';
+
+// Struct used to describe a particular configuration of cars on the board
+template <typename TGeometry>
+struct BoardT
+{
+	typedef TGeometry Geometry;
+	static constexpr int WIDTH = TGeometry::WIDTH;
+	static constexpr int HEIGHT = TGeometry::HEIGHT;
+	static constexpr int EXIT_Y = TGeometry::EXIT_Y;
+
+	// We represent the board as a simple 2D grid.  Each cell is
+	// a printable-character.  A space character (' ') is used
+	// to denote an empty cell.  Each car should be assigned a unique
+	// character (e.g. letters or numbers).  The goal car we are trying
+	// to get out of the garage must be assigned the character 'X'.
+	// Walls, which never move, are WALL_CELL.
+	//
+	// The array should be indexed [y][x], where y is the row index
+	// and x is the column index
+	char cell[HEIGHT][WIDTH];
+
+	// Define a comparison operator, so that we can
+	// establish an ordering over the set of board states.
+	inline bool operator<( const BoardT &x ) const
+	{
+		return memcmp( cell, x.cell, sizeof(cell) ) < 0;
+	}
+
+	// Check if two board states are the same
+	inline bool operator==( const BoardT &x ) const
+	{
+		return memcmp( cell, x.cell, sizeof(cell) ) == 0;
+	}
+
+	// Compute a hash of the board state, for use in a hash table.
+	// We just treat the grid as a string of bytes, and fold it
+	// 8 bytes at a time into a 64-bit value.
+	uint64_t Hash() const
+	{
+		const char *p = &cell[0][0];
+		uint64_t h = 0;
+		size_t n = sizeof(cell);
+		while ( n >= 8 )
+		{
+			uint64_t chunk;
+			memcpy( &chunk, p, 8 );
+			h = HashMix64( h ^ chunk );
+			p += 8;
+			n -= 8;
+		}
+		if ( n > 0 )
+		{
+			uint64_t chunk = 0;
+			memcpy( &chunk, p, n );
+			h = HashMix64( h ^ chunk );
+		}
+		return h;
+	}
+
+	// Return the value of cell[y][x].  Assert if we are out of bounds
+	char Cell( int y, int x ) const
+	{
+		assert( x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT );
+		return cell[y][x];
+	}
+
+	// Return the value of cell[y][x], but return 0 if the coords
+	// are off the board
+	char CellSafe( int y, int x ) const
+	{
+		if ( x < 0 || x >= WIDTH || y < 0 || y >= HEIGHT )
+			return 0;
+		return cell[y][x];
+	}
+
+	// Set a cell value, with bounds checking
+	void SetCell( int y, int x, char c )
+	{
+		assert( x >= 0 && x < WIDTH && y >= 0 && y < HEIGHT );
+		cell[y][x] = c;
+	}
+
+	// Parse a board from a single line of text, listing the rows
+	// from top to bottom, WIDTH characters each.  This is the
+	// same layout as the cards that come with the game, just with
+	// the rows run together.  Empty cells can be written as ' ' or
+	// '.'.  If the line is short, the rest of the board is empty,
+	// since trailing spaces are easy to lose in a text file.
+	// Returns false if there's no line, or it is too long or
+	// contains a character that isn't printable.
+	bool Parse( const char *text )
+	{
+		memset( cell, ' ', sizeof(cell) );
+		if ( !text )
+			return false;
+		size_t len = strlen( text );
+		if ( len > sizeof(cell) )
+			return false;
+		for ( size_t i = 0 ; i < len ; ++i )
+		{
+			char c = text[i];
+			if ( c < ' ' || c > '~' )
+				return false;
+			cell[i/WIDTH][i%WIDTH] = c == '.' ? ' ' : c;
+		}
+		return true;
+	}
+
+	// Starting next to cell (y,x), and stepping by (dy,dx), skip
+	// over empty cells.  Return true if we then find the label c.
+	bool FindAlongLine( int y, int x, int dy, int dx, char c ) const
+	{
+		do
+		{
+			y += dy;
+			x += dx;
+		} while ( CellSafe( y, x ) == ' ' );
+		return CellSafe( y, x ) == c;
+	}
+
+	// Print this board state.  If there is a next state,
+	// then optionally draw an arrow to show shat the move is
+	void Print( const char *indent, const BoardT *next ) const
+	{
+		if ( !next ) next = this; // !KLUDGE! If not asking to show the move to the next state, just set next to be same as self
+		for ( int y = 0 ; y < HEIGHT ; ++y )
+		{
+			printf( "%s", indent );
+			for ( int x = 0 ; x < WIDTH ; ++x )
+			{
+
+				// Assume we won't print an arrow
+				char c = Cell( y, x );
+
+				// See if next board state differs here
+				char n = next->Cell( y, x );
+				if ( c != n )
+				{
+					if ( c == ' ' )
+					{
+
+						// This is where the move happened.  FIgure which
+						// direction arrow to draw.  The car might have slid
+						// more than one square, so look past empty cells.
+						if ( FindAlongLine( y, x, 0, -1, n ) )
+							c = '>';
+						else if ( FindAlongLine( y, x, 0, 1, n ) )
+							c = '<';
+						else if ( FindAlongLine( y, x, -1, 0, n ) )
+							c = 'v';
+						else if ( FindAlongLine( y, x, 1, 0, n ) )
+							c = '^';
+						else
+							assert( false ); // Next state is not reachable from this state by a simple move
+					}
+					else if ( n == ' ' && y == EXIT_Y && x < WIDTH-1 )
+					{
+						// Check for the special mode where a car leaves the board entirely
+						bool bCarLeftBoard = true;
+						for ( int xx = x+1 ; xx < WIDTH ; ++xx )
+						{
+							if ( next->Cell( y, xx ) != ' ' || ( Cell( y, xx ) != ' ' && Cell( y, xx ) != c ) )
+							{
+								bCarLeftBoard = false;
+								break;
+							}
+						}
+						if ( bCarLeftBoard )
+						{
+							while ( x < WIDTH && c == Cell( y, x ) )
+							{
+								printf( "%c", c );
+								++x;
+							}
+							while ( x < WIDTH+1 )
+							{
+								printf( ">" );
+								++x;
+							}
+							break;
+						}
+					}
+				}
+				printf( "%c", c );
+			}
+			printf( "\n" );
+		}
+	}
+};
+
+// The standard board
+typedef BoardT<StandardGeometry> Board;
+
+// Pick the size of board from a line of text in the format read by
+// BoardT::Parse.  Lines can be short, so we pick the smallest board
+// that it fits on.  (So a 7x7 board needs at least one car in the
+// last row or two.)  Returns the width, or 0 if it's too long for
+// any of them.
+inline int BoardSizeForText( const char *text )
+{
+	const size_t len = strlen( text );
+	if ( len <= (size_t)Geometry6x6::CELLS )
+		return 6;
+	if ( len <= (size_t)Geometry7x7::CELLS )
+		return 7;
+	if ( len <= (size_t)Geometry8x8::CELLS )
+		return 8;
+	return 0;
+}
+
+// Tell HashSet how to store boards.  We use a board
+// of all zeros to mark an empty slot.  A real board never
+// contains a zero character, since empty cells are ' '.
+template <typename TGeometry>
+struct HashSetTraits< BoardT<TGeometry> >
+{
+	typedef BoardT<TGeometry> TBoard;
+	static uint64_t Hash( const TBoard &b ) { return b.Hash(); }
+	static bool IsEmpty( const TBoard &b ) { return b.cell[0][0] == 0; }
+	static TBoard Empty() { TBoard b; memset( &b, 0, sizeof(b) ); return b; }
+};
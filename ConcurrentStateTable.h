@@ -0,0 +1,291 @@
+//
+// Table of visited states that can be shared by several threads
+//
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+
+#include "HashSet.h"
+
+// A set of packed states that many threads can insert into
+// at the same time, without taking any locks.  Each state also
+// carries a 64-bit tag, and when the same state is inserted more
+// than once, the table keeps the smallest tag.
+//
+// The parallel search uses the tag to remember which move
+// reached the state first, in the order the serial search would
+// have generated it.  That way, no matter which thread happens
+// to insert a state first, the search still picks the same
+// parent for it, and finds exactly the same solution.
+//
+// The table is a flat array of slots with linear probing, like
+// HashSet.  A slot starts out empty, and a thread claims it
+// with an atomic compare-and-swap.  If two threads try to claim
+// the same slot, exactly one of them wins.  The loser looks at
+// what the winner wrote, and either discovers that it was the
+// same state, or keeps probing.  A slot never changes once it
+// has been claimed, which is what makes this simple to reason
+// about.
+//
+// We never resize the table while threads are inserting.  (That
+// can be done without locks, but it's very tricky.)  Instead, the
+// capacity is fixed, and each state may only be placed within the
+// first few slots of its probe sequence.  If all of those slots
+// are taken by other states, the state goes into a small
+// "overflow" table protected by a lock.  Since slots only ever go
+// from empty to full, once a probe window is full it stays full,
+// so every thread that inserts that state will agree to use the
+// overflow table.  The owner of the table calls Reserve() at a
+// quiet moment (for the search, in between layers) to grow the
+// main table and move the overflow states back into it.
+class ConcurrentStateTable
+{
+public:
+
+	ConcurrentStateTable()
+	{
+		Reserve( 0 );
+	}
+
+	// Make sure the table can hold this many states while staying
+	// at most half full, and move any overflow entries into the
+	// main table.  This is not safe to call while other threads
+	// are inserting.
+	void Reserve( size_t expected_count )
+	{
+		size_t capacity = m_capacity ? m_capacity : 1024;
+		while ( capacity < expected_count*2 )
+			capacity *= 2;
+		if ( capacity == m_capacity && m_overflow.size() == 0 )
+			return;
+		if ( m_overflow.size() > 0 && capacity == m_capacity )
+			capacity *= 2;
+		Rehash( capacity );
+	}
+
+	// Remove all of the states, but keep the memory, so the table
+	// can be reused without allocating.  Not safe to call while
+	// other threads are inserting.
+	void Clear()
+	{
+		for ( size_t i = 0 ; i < m_capacity ; ++i )
+		{
+			m_slots[i].state.store( EMPTY, std::memory_order_relaxed );
+			m_slots[i].tag.store( ~0ull, std::memory_order_relaxed );
+		}
+		m_overflow.Clear();
+		m_overflow_count.store( 0, std::memory_order_relaxed );
+	}
+
+	// Remove all of the states, and if the table has been much bigger
+	// than it needed to be for expected_count states several times in
+	// a row, free it and start over with a smaller one.  (Same as
+	// HashSet::ClearAndShrink.)  Not safe to call while other threads
+	// are inserting.
+	void ClearAndShrink( size_t expected_count )
+	{
+		size_t capacity = 1024;
+		while ( capacity < expected_count*2 )
+			capacity *= 2;
+		if ( m_capacity <= capacity*SHRINK_FACTOR )
+			m_oversized_clears = 0;
+		else if ( ++m_oversized_clears >= SHRINK_AFTER_CLEARS )
+		{
+			PageArray<Slot>().swap( m_slots );
+			m_capacity = 0;
+			m_oversized_clears = 0;
+			m_overflow.Clear();
+			Rehash( capacity );
+			return;
+		}
+		Clear();
+	}
+
+	// Insert a state with the given tag.  Returns true if the state
+	// was not already present.  If it was already present, and this
+	// tag is smaller than the one in the table, the tag is lowered.
+	// Safe to call from any number of threads at once.
+	bool InsertOrLowerTag( uint64_t state, uint64_t tag )
+	{
+		assert( state != EMPTY );
+		size_t idx = HashMix64( state ) & m_mask;
+		for ( int probe = 0 ; probe < MAX_PROBES ; ++probe )
+		{
+			Slot &slot = m_slots[idx];
+			uint64_t cur = slot.state.load( std::memory_order_acquire );
+			if ( cur == EMPTY )
+			{
+				// Try to claim it.  If we fail, cur is updated
+				// with the state that some other thread wrote.
+				if ( slot.state.compare_exchange_strong( cur, state, std::memory_order_acq_rel, std::memory_order_acquire ) )
+				{
+					LowerTag( slot.tag, tag );
+					return true;
+				}
+			}
+			if ( cur == state )
+			{
+				LowerTag( slot.tag, tag );
+				return false;
+			}
+			idx = ( idx + 1 ) & m_mask;
+		}
+
+		// Probe window is full.  Use the overflow table.
+		m_overflow_count.fetch_add( 1, std::memory_order_relaxed );
+		std::lock_guard<std::mutex> lock( m_overflow_lock );
+		std::pair<OverflowEntry *, bool> result = m_overflow.FindOrInsert( OverflowEntry{ state, tag } );
+		if ( !result.second && tag < result.first->tag )
+			result.first->tag = tag;
+		return result.second;
+	}
+
+	// Return the tag of a state that is in the table.  This can
+	// be called from several threads at once, but not while any
+	// thread is inserting.
+	uint64_t Tag( uint64_t state ) const
+	{
+		size_t idx = HashMix64( state ) & m_mask;
+		for ( int probe = 0 ; probe < MAX_PROBES ; ++probe )
+		{
+			const Slot &slot = m_slots[idx];
+			uint64_t cur = slot.state.load( std::memory_order_relaxed );
+			if ( cur == state )
+				return slot.tag.load( std::memory_order_relaxed );
+			assert( cur != EMPTY );
+			idx = ( idx + 1 ) & m_mask;
+		}
+		const OverflowEntry *e = m_overflow.Find( OverflowEntry{ state, 0 } );
+		assert( e );
+		return e->tag;
+	}
+
+	// Count the states in the table.  This has to scan the whole
+	// table, and is not safe while other threads are inserting.
+	size_t size() const
+	{
+		size_t total = m_overflow.size();
+		for ( size_t i = 0 ; i < m_capacity ; ++i )
+		{
+			if ( m_slots[i].state.load( std::memory_order_relaxed ) != EMPTY )
+				++total;
+		}
+		return total;
+	}
+
+	// Number of slots in the main table
+	size_t Capacity() const { return m_capacity; }
+
+	// Same as HashSet::MeasureProbes.  States in the overflow table
+	// count as MAX_PROBES, plus however long it took to find them
+	// there.  Not safe while other threads are inserting.
+	size_t MeasureProbes( uint64_t &out_total, uint64_t &out_longest ) const
+	{
+		m_overflow.MeasureProbes( out_total, out_longest );
+		out_total += m_overflow.size() * MAX_PROBES;
+		if ( m_overflow.size() > 0 )
+			out_longest += MAX_PROBES;
+		size_t count = m_overflow.size();
+		for ( size_t idx = 0 ; idx < m_capacity ; ++idx )
+		{
+			const uint64_t state = m_slots[idx].state.load( std::memory_order_relaxed );
+			if ( state == EMPTY )
+				continue;
+			const uint64_t length = ( ( idx - HashMix64( state ) ) & m_mask ) + 1;
+			out_total += length;
+			if ( length > out_longest )
+				out_longest = length;
+			++count;
+		}
+		return count;
+	}
+
+	// Number of times an insert had to use the overflow table,
+	// since the last time it was reset
+	uint64_t OverflowInserts() const { return m_overflow_count.load( std::memory_order_relaxed ); }
+
+private:
+
+	// A state value that never occurs, used to mark an empty slot
+	static constexpr uint64_t EMPTY = ~0ull;
+
+	// How far we will probe in the main table before giving up and
+	// using the overflow table.  At half full, a probe sequence this
+	// long is extremely unlikely.
+	static constexpr int MAX_PROBES = 32;
+
+	// Same as in HashSet
+	static constexpr size_t SHRINK_FACTOR = 8;
+	static constexpr int SHRINK_AFTER_CLEARS = 8;
+
+	struct Slot
+	{
+		std::atomic<uint64_t> state;
+		std::atomic<uint64_t> tag;
+	};
+
+	// Lower an atomic tag to the given value, if it is smaller
+	static void LowerTag( std::atomic<uint64_t> &slot_tag, uint64_t tag )
+	{
+		uint64_t cur = slot_tag.load( std::memory_order_relaxed );
+		while ( tag < cur && !slot_tag.compare_exchange_weak( cur, tag, std::memory_order_relaxed ) )
+			;
+	}
+
+	PageArray<Slot> m_slots;
+	size_t m_capacity = 0;
+	size_t m_mask = 0;
+	int m_oversized_clears = 0;
+
+	// Overflow table, for states that didn't fit in their
+	// probe window.  Protected by m_overflow_lock.
+	struct OverflowEntry
+	{
+		uint64_t state;
+		uint64_t tag;
+		bool operator==( const OverflowEntry &x ) const { return state == x.state; }
+	};
+	struct OverflowTraits
+	{
+		static uint64_t Hash( const OverflowEntry &e ) { return HashMix64( e.state ); }
+		static bool IsEmpty( const OverflowEntry &e ) { return e.state == EMPTY; }
+		static OverflowEntry Empty() { return OverflowEntry{ EMPTY, 0 }; }
+	};
+	std::mutex m_overflow_lock;
+	HashSet<OverflowEntry, OverflowTraits> m_overflow;
+	std::atomic<uint64_t> m_overflow_count { 0 };
+
+	// Allocate a new array of slots and reinsert all of the
+	// states from the old one, and the overflow table.
+	void Rehash( size_t new_capacity )
+	{
+		assert( ( new_capacity & ( new_capacity-1 ) ) == 0 );
+		PageArray<Slot> old_slots( new_capacity );
+		for ( size_t i = 0 ; i < new_capacity ; ++i )
+		{
+			old_slots[i].state.store( EMPTY, std::memory_order_relaxed );
+			old_slots[i].tag.store( ~0ull, std::memory_order_relaxed );
+		}
+		old_slots.swap( m_slots );
+		const size_t old_capacity = m_capacity;
+		m_capacity = new_capacity;
+		m_mask = new_capacity-1;
+
+		HashSet<OverflowEntry, OverflowTraits> old_overflow;
+		old_overflow.Swap( m_overflow );
+		m_overflow_count.store( 0, std::memory_order_relaxed );
+
+		for ( size_t i = 0 ; i < old_capacity ; ++i )
+		{
+			uint64_t state = old_slots[i].state.load( std::memory_order_relaxed );
+			if ( state != EMPTY )
+				InsertOrLowerTag( state, old_slots[i].tag.load( std::memory_order_relaxed ) );
+		}
+		old_overflow.ForEach( [this]( const OverflowEntry &e )
+		{
+			InsertOrLowerTag( e.state, e.tag );
+		} );
+	}
+};
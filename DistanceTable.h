@@ -0,0 +1,663 @@
+//
+// Table of the distance to the goal from every state of a puzzle
+//
+// A board only ever has the same vehicles on it, sliding along the
+// same tracks.  So starting from a board, there is a fixed set of
+// states we can ever reach, and for a 6x6 board it's small enough to
+// explore all of it.  Once we've done that, and worked out how many
+// moves each of those states is from being solved, we can save it to
+// a file.  From then on, any position that comes up while playing
+// that puzzle can be answered instantly, without searching: look up
+// its distance, then take any move that gets one closer.  That's all
+// a "hint" button needs.
+//
+// DistanceTable builds the table and writes the file.
+// DistanceDatabase reads it.  The file is designed to be used
+// exactly as it is on disk, without reading it into memory or
+// building anything from it: we just map the file into memory and
+// look things up in it directly.  So opening a database takes the
+// same (tiny) amount of time no matter how big it is, and when
+// several processes open the same file, they all share one copy of
+// it in memory.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "BitBoard.h"
+
+// Values returned when asking for the distance of a state, instead
+// of a number of moves
+constexpr int DISTANCE_UNSOLVABLE = -1;
+constexpr int DISTANCE_NOT_IN_TABLE = -2;
+
+// Convert a board into a state for the given vehicles.  The board must
+// have the same vehicles, on the same tracks, with the same labels,
+// although vehicles that can exit may be missing.  Returns false
+// if it doesn't.
+inline bool BoardToTableState( const VehicleTable &vehicles, const Board &board, PackedState &out_state )
+{
+	VehicleTable board_vehicles;
+	PackedState board_state;
+	std::string error;
+	if ( !board_vehicles.Init( board, board_state, &error ) || board_vehicles.count > vehicles.count || board_vehicles.walls != vehicles.walls )
+		return false;
+
+	// Vehicles are numbered in the order they are first found on
+	// the board, which depends on where they are.  So match them
+	// up by label.
+	out_state = 0;
+	int matched = 0;
+	for ( int v = 0 ; v < vehicles.count ; ++v )
+	{
+		const Vehicle &veh = vehicles.vehicle[v];
+		int offset = OFFSET_EXITED;
+		const int bv = board_vehicles.Find( veh.label );
+		if ( bv >= 0 )
+		{
+			const Vehicle &board_veh = board_vehicles.vehicle[bv];
+			if ( board_veh.horizontal != veh.horizontal || board_veh.length != veh.length || board_veh.base_mask != veh.base_mask )
+				return false;
+			offset = VehicleTable::Offset( board_state, bv );
+			++matched;
+		}
+		else if ( !veh.can_exit )
+		{
+			return false;
+		}
+		out_state |= PackedState( offset ) << ( v*OFFSET_BITS );
+	}
+	return matched == board_vehicles.count;
+}
+
+//
+// File format
+//
+// The file starts with this header.  The rest of the file is three
+// arrays, at the offsets given in the header:
+//
+//   seeds         uint32_t per bucket, for the perfect hash (see below)
+//   fingerprints  uint16_t per state
+//   distances     4 or 8 bits per state
+//
+// Numbers are stored in the byte order of the machine, and each
+// array starts on an 8-byte boundary, so they can be used in place.
+//
+// To find a state, we need to know where it is in those arrays.  We
+// use a "minimal perfect hash": a hash function that, for the states in
+// the file, gives every state a different slot, with no empty slots.
+// There is no way to find such a function for an arbitrary set of
+// keys in one go, but there is a simple trick ("hash and displace").
+// First, hash each state into a bucket, with a few states per bucket.
+// Then, for each bucket, find a seed such that hashing the states in
+// that bucket together with the seed sends them all to slots that are
+// not yet taken.  We store just the seed for each bucket, which is
+// a few bits per state.  Finding a state is then two hashes: one to
+// find its bucket and the seed, and one to find its slot.
+//
+// The perfect hash will happily give a slot for a state that isn't in
+// the file, too.  So each slot also has a 16-bit fingerprint (another
+// hash) of the state that belongs there.  If the fingerprint doesn't
+// match, the state isn't in the file.  But a state that isn't in the
+// file gets through anyway one time in 65536, and then we get a
+// made-up distance.  So DistanceDatabase::Solve checks the answer: it
+// follows the distances down to the goal, and only trusts them if that
+// really is a solution of the right length.  A state the table says
+// can't be solved can't be checked like that, so we don't trust those
+// at all, and search instead.
+
+struct DistanceFileHeader
+{
+	char magic[4];
+	uint32_t version;
+	uint32_t vehicle_count;
+	uint32_t goal;
+
+	// Mask of the wall cells
+	uint64_t walls;
+
+	// The vehicles.  The file only stores the properties that
+	// VehicleTable::Init figures out from the board.  The rest
+	// follow from those.
+	struct SavedVehicle
+	{
+		uint64_t base_mask;
+		char label;
+		uint8_t horizontal;
+		uint8_t length;
+		uint8_t can_exit;
+		uint32_t unused;
+	} vehicles[MAX_VEHICLES];
+
+	uint64_t state_count;
+	uint64_t bucket_count;
+
+	// Bits per distance, 4 or 8.  The largest value means the state
+	// can't reach the goal.
+	uint32_t distance_bits;
+	uint32_t max_distance;
+
+	// Where the arrays are, in bytes from the start of the file
+	uint64_t seeds_offset;
+	uint64_t fingerprints_offset;
+	uint64_t distances_offset;
+	uint64_t file_size;
+};
+
+constexpr char DISTANCE_FILE_MAGIC[4] = { 'R', 'H', 'D', 'B' };
+constexpr uint32_t DISTANCE_FILE_VERSION = 3;
+
+// Check that the vehicles in a file header are ones that
+// VehicleTable::Init could have made from a board: each one a
+// straight line of cells on the board, at the start of its track,
+// with its own printable label, and the goal car horizontal in the
+// exit row.  We use them to make masks and index the board, so a
+// damaged file could otherwise have us reading off the end of things.
+inline bool ValidDistanceFileVehicles( const DistanceFileHeader &h )
+{
+	const uint64_t board_mask = ( 1ull << VehicleTable::CELLS ) - 1;
+	if ( h.walls & ~board_mask )
+		return false;
+	for ( uint32_t v = 0 ; v < h.vehicle_count ; ++v )
+	{
+		const DistanceFileHeader::SavedVehicle &sv = h.vehicles[v];
+		if ( sv.label <= ' ' || sv.label > '~' || sv.label == WALL_CELL )
+			return false;
+		for ( uint32_t w = 0 ; w < v ; ++w )
+		{
+			if ( h.vehicles[w].label == sv.label )
+				return false;
+		}
+		if ( sv.length < 1 || sv.length > BOARD_SIZE || sv.horizontal > 1 || sv.can_exit > 1 )
+			return false;
+		if ( sv.base_mask == 0 || ( sv.base_mask & ~board_mask ) )
+			return false;
+
+		// A vehicle of length 1 can be anywhere.  Anything longer
+		// starts at the left edge or the top.
+		const int first = __builtin_ctzll( sv.base_mask );
+		const int y = first / BOARD_SIZE;
+		const int x = first % BOARD_SIZE;
+		uint64_t expected = 0;
+		if ( sv.length == 1 )
+			expected = sv.horizontal ? VehicleTable::CellBit( y, x ) : 0;
+		else if ( sv.horizontal && x == 0 )
+			expected = ( ( 1ull << sv.length ) - 1 ) << first;
+		else if ( !sv.horizontal && y == 0 )
+		{
+			for ( int i = 0 ; i < sv.length ; ++i )
+				expected |= VehicleTable::CellBit( i, x );
+		}
+		if ( sv.base_mask != expected )
+			return false;
+		const bool can_exit = sv.horizontal && sv.length > 1 && v != h.goal && y == BOARD_EXIT_Y;
+		if ( sv.can_exit != can_exit )
+			return false;
+	}
+	const DistanceFileHeader::SavedVehicle &goal = h.vehicles[h.goal];
+	return goal.horizontal && goal.length > 1 && __builtin_ctzll( goal.base_mask ) / BOARD_SIZE == BOARD_EXIT_Y;
+}
+
+// Average number of states per bucket of the perfect hash.  Larger
+// buckets make the seed table smaller, but the seeds harder to find.
+constexpr int DISTANCE_STATES_PER_BUCKET = 4;
+
+// Map a 64-bit hash onto the range [0,n) without a division
+inline uint64_t HashToRange( uint64_t h, uint64_t n )
+{
+	return uint64_t( ( (unsigned __int128)h * n ) >> 64 );
+}
+
+// The hash functions used by the file
+inline uint64_t DistanceFileBucket( PackedState state, uint64_t bucket_count )
+{
+	return HashToRange( HashMix64( state ), bucket_count );
+}
+inline uint64_t DistanceFileSlot( PackedState state, uint32_t seed, uint64_t state_count )
+{
+	return HashToRange( HashMix64( state ^ ( ( seed+1ull ) * 0x9e3779b97f4a7c15ull ) ), state_count );
+}
+inline uint16_t DistanceFileFingerprint( PackedState state )
+{
+	return uint16_t( HashMix64( state ^ 0xc2b2ae3d27d4eb4full ) >> 48 );
+}
+
+// Find the distances for a puzzle, and write them to a file
+class DistanceTable
+{
+public:
+
+	// Explore every state reachable from the board, and work out the
+	// distance to the goal from each one.  Returns false if the board
+	// is not valid, with the reason in out_error.
+	//
+	// This is done in two passes.  First, a breadth-first search from
+	// the board, just like the solver, except that it keeps going
+	// after it finds a solution, until there's nothing new left to
+	// find.  Then a second breadth-first search that runs backward
+	// (a "retrograde" search), starting from all of the solved states
+	// at once, using ForEachReverseMove.  The first time that search
+	// reaches a state, we know the shortest distance from that state
+	// to any solved state.  We only follow moves between states that
+	// the first pass found, since those are the only ones we store.
+	bool Build( const Board &board, std::string &out_error )
+	{
+		PackedState initial_state;
+		if ( !m_vehicles.Init( board, initial_state, &out_error ) )
+			return false;
+
+		// Pass 1: find all of the states
+		m_states.clear();
+		m_index.Clear();
+		m_states.push_back( initial_state );
+		m_index.Insert( IndexedState{ initial_state, 0 } );
+		for ( size_t idx_state = 0 ; idx_state < m_states.size() ; ++idx_state )
+		{
+			m_vehicles.ForEachMove( m_states[idx_state], [&]( PackedState next )
+			{
+				if ( m_index.Insert( IndexedState{ next, (int)m_states.size() } ) )
+					m_states.push_back( next );
+			} );
+		}
+
+		// Pass 2: retrograde search from the solved states.  The
+		// queue is a list of indices, in order of distance.
+		m_distances.assign( m_states.size(), UNSOLVABLE );
+		m_max_distance = 0;
+		std::vector<int> queue;
+		queue.reserve( m_states.size() );
+		for ( int i = 0 ; i < (int)m_states.size() ; ++i )
+		{
+			if ( m_vehicles.IsSolved( m_states[i] ) )
+			{
+				m_distances[i] = 0;
+				queue.push_back( i );
+			}
+		}
+		for ( size_t q = 0 ; q < queue.size() ; ++q )
+		{
+			const int cur = queue[q];
+			const int next_distance = m_distances[cur] + 1;
+			m_vehicles.ForEachReverseMove( m_states[cur], [&]( PackedState prev )
+			{
+				const IndexedState *s = m_index.Find( IndexedState{ prev, -1 } );
+				if ( s && m_distances[s->index] == UNSOLVABLE )
+				{
+					m_distances[s->index] = (uint8_t)next_distance;
+					m_max_distance = next_distance;
+					queue.push_back( s->index );
+				}
+			} );
+			if ( m_max_distance >= UNSOLVABLE )
+			{
+				out_error = "Solution is too long to store in the table";
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// The vehicles that the table is for
+	const VehicleTable &Vehicles() const { return m_vehicles; }
+
+	// Number of states in the table
+	size_t size() const { return m_states.size(); }
+
+	// Number of moves from a state to the goal, or one of the
+	// DISTANCE_xxx values
+	int Distance( PackedState state ) const
+	{
+		const IndexedState *s = m_index.Find( IndexedState{ state, -1 } );
+		if ( !s )
+			return DISTANCE_NOT_IN_TABLE;
+		if ( m_distances[s->index] == UNSOLVABLE )
+			return DISTANCE_UNSOLVABLE;
+		return m_distances[s->index];
+	}
+
+	// Convert a board into a state of this table
+	bool StateFromBoard( const Board &board, PackedState &out_state ) const
+	{
+		return BoardToTableState( m_vehicles, board, out_state );
+	}
+
+	// Write the table to a file, for DistanceDatabase to read
+	bool Save( const char *filename ) const
+	{
+		const uint64_t state_count = m_states.size();
+		const uint64_t bucket_count = ( state_count + DISTANCE_STATES_PER_BUCKET-1 ) / DISTANCE_STATES_PER_BUCKET;
+
+		// Group the states by bucket
+		std::vector<uint32_t> bucket_start( bucket_count+1, 0 );
+		for ( PackedState s: m_states )
+			++bucket_start[ DistanceFileBucket( s, bucket_count ) + 1 ];
+		for ( uint64_t b = 0 ; b < bucket_count ; ++b )
+			bucket_start[b+1] += bucket_start[b];
+		std::vector<uint32_t> bucket_states( state_count );
+		{
+			std::vector<uint32_t> fill( bucket_start.begin(), bucket_start.end()-1 );
+			for ( uint32_t i = 0 ; i < state_count ; ++i )
+				bucket_states[ fill[ DistanceFileBucket( m_states[i], bucket_count ) ]++ ] = i;
+		}
+
+		// Find a seed for each bucket.  We do the biggest buckets first,
+		// while there are plenty of free slots, because those are the
+		// hardest to fit.  A bucket with one state in it is easy to fit
+		// even when the table is almost full.
+		std::vector<uint32_t> bucket_order( bucket_count );
+		for ( uint32_t b = 0 ; b < bucket_count ; ++b )
+			bucket_order[b] = b;
+		std::stable_sort( bucket_order.begin(), bucket_order.end(), [&]( uint32_t a, uint32_t b )
+		{
+			return bucket_start[a+1] - bucket_start[a] > bucket_start[b+1] - bucket_start[b];
+		} );
+		std::vector<uint32_t> seeds( bucket_count, 0 );
+		std::vector<uint32_t> slot_state( state_count, UINT32_MAX );
+		std::vector<uint64_t> slots;
+		for ( uint32_t b: bucket_order )
+		{
+			const uint32_t begin = bucket_start[b], end = bucket_start[b+1];
+			if ( begin == end )
+				continue;
+			for ( uint32_t seed = 0 ; ; ++seed )
+			{
+				if ( seed == UINT32_MAX )
+					return false;
+				slots.clear();
+				bool fits = true;
+				for ( uint32_t i = begin ; i < end && fits ; ++i )
+				{
+					uint64_t slot = DistanceFileSlot( m_states[ bucket_states[i] ], seed, state_count );
+					fits = slot_state[slot] == UINT32_MAX && std::find( slots.begin(), slots.end(), slot ) == slots.end();
+					slots.push_back( slot );
+				}
+				if ( fits )
+				{
+					for ( uint32_t i = begin ; i < end ; ++i )
+						slot_state[ slots[i-begin] ] = bucket_states[i];
+					seeds[b] = seed;
+					break;
+				}
+			}
+		}
+
+		// Fill in the fingerprints and distances, in slot order.  If
+		// all the distances fit in 4 bits, pack two per byte.
+		DistanceFileHeader header;
+		memset( &header, 0, sizeof(header) );
+		header.distance_bits = m_max_distance < 15 ? 4 : 8;
+		const uint8_t unsolvable = header.distance_bits == 4 ? 15 : UNSOLVABLE;
+		std::vector<uint16_t> fingerprints( state_count );
+		std::vector<uint8_t> distances( header.distance_bits == 4 ? ( state_count+1 ) / 2 : state_count, 0 );
+		for ( uint64_t slot = 0 ; slot < state_count ; ++slot )
+		{
+			const uint32_t i = slot_state[slot];
+			fingerprints[slot] = DistanceFileFingerprint( m_states[i] );
+			const uint8_t d = m_distances[i] == UNSOLVABLE ? unsolvable : m_distances[i];
+			if ( header.distance_bits == 4 )
+				distances[slot/2] |= d << ( ( slot & 1 ) * 4 );
+			else
+				distances[slot] = d;
+		}
+
+		// Lay out the file
+		auto Align = []( uint64_t offset ) { return ( offset + 7 ) & ~uint64_t(7); };
+		memcpy( header.magic, DISTANCE_FILE_MAGIC, 4 );
+		header.version = DISTANCE_FILE_VERSION;
+		header.vehicle_count = m_vehicles.count;
+		header.goal = m_vehicles.goal;
+		header.walls = m_vehicles.walls;
+		for ( int v = 0 ; v < m_vehicles.count ; ++v )
+		{
+			const Vehicle &veh = m_vehicles.vehicle[v];
+			header.vehicles[v].base_mask = veh.base_mask;
+			header.vehicles[v].label = veh.label;
+			header.vehicles[v].horizontal = veh.horizontal;
+			header.vehicles[v].length = (uint8_t)veh.length;
+			header.vehicles[v].can_exit = veh.can_exit;
+		}
+		header.state_count = state_count;
+		header.bucket_count = bucket_count;
+		header.max_distance = m_max_distance;
+		header.seeds_offset = Align( sizeof(header) );
+		header.fingerprints_offset = Align( header.seeds_offset + seeds.size()*sizeof(uint32_t) );
+		header.distances_offset = Align( header.fingerprints_offset + fingerprints.size()*sizeof(uint16_t) );
+		header.file_size = header.distances_offset + distances.size();
+
+		FILE *f = fopen( filename, "wb" );
+		if ( !f )
+			return false;
+		bool ok = true;
+		auto Write = [&]( uint64_t offset, const void *data, size_t size )
+		{
+			static const char zeros[8] = {};
+			const long pos = ftell( f );
+			ok = ok && pos >= 0 && (uint64_t)pos <= offset && fwrite( zeros, 1, offset - pos, f ) == offset - pos;
+			ok = ok && fwrite( data, 1, size, f ) == size;
+		};
+		Write( 0, &header, sizeof(header) );
+		Write( header.seeds_offset, seeds.data(), seeds.size()*sizeof(uint32_t) );
+		Write( header.fingerprints_offset, fingerprints.data(), fingerprints.size()*sizeof(uint16_t) );
+		Write( header.distances_offset, distances.data(), distances.size() );
+		ok = ( fclose( f ) == 0 ) && ok;
+		return ok;
+	}
+
+private:
+
+	// Distance we store for a state that can't reach the goal at all
+	static constexpr uint8_t UNSOLVABLE = 0xff;
+
+	VehicleTable m_vehicles;
+
+	// All the states, and the distance to the goal from each one
+	std::vector<PackedState> m_states;
+	std::vector<uint8_t> m_distances;
+	int m_max_distance = 0;
+
+	// Where each state is in m_states
+	HashSet<IndexedState> m_index;
+};
+
+// A distance table file, mapped into memory and used in place
+class DistanceDatabase
+{
+public:
+
+	DistanceDatabase() {}
+	~DistanceDatabase() { Close(); }
+	DistanceDatabase( const DistanceDatabase & ) = delete;
+	DistanceDatabase &operator=( const DistanceDatabase & ) = delete;
+
+	// Map a file written by DistanceTable::Save.  We only check the
+	// header (including the vehicles), so this takes the same time
+	// however big the file is.
+	// Returns false, with the reason in out_error, if the file can't
+	// be used.
+	bool Open( const char *filename, std::string &out_error )
+	{
+		Close();
+		int fd = open( filename, O_RDONLY );
+		if ( fd < 0 )
+		{
+			out_error = std::string( "Can't open " ) + filename;
+			return false;
+		}
+		struct stat st;
+		void *data = MAP_FAILED;
+		if ( fstat( fd, &st ) == 0 && (size_t)st.st_size >= sizeof(DistanceFileHeader) )
+			data = mmap( nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0 );
+		close( fd );
+		if ( data == MAP_FAILED )
+		{
+			out_error = std::string( filename ) + " is not a valid distance table";
+			return false;
+		}
+		m_data = (const uint8_t *)data;
+		m_size = st.st_size;
+
+		// Check that the header makes sense, and everything
+		// it points to is inside the file
+		const DistanceFileHeader &h = *(const DistanceFileHeader *)m_data;
+		const uint64_t distance_bytes = h.distance_bits == 4 ? ( h.state_count+1 ) / 2 : h.state_count;
+
+		// An array of count items of the given size, starting at offset,
+		// must be after the header and end inside the file.  (Written
+		// so that a huge offset or count can't wrap around.)
+		const uint64_t file_size = m_size;
+		auto ArrayInFile = [file_size]( uint64_t offset, uint64_t count, uint64_t item_size )
+		{
+			return offset % 8 == 0 && offset >= sizeof(DistanceFileHeader) && offset <= file_size
+				&& count <= ( file_size - offset ) / item_size;
+		};
+		const bool ok = memcmp( h.magic, DISTANCE_FILE_MAGIC, 4 ) == 0
+			&& h.version == DISTANCE_FILE_VERSION
+			&& h.file_size == m_size
+			&& h.vehicle_count <= MAX_VEHICLES && h.goal < h.vehicle_count
+			&& ( h.distance_bits == 4 || h.distance_bits == 8 )
+			&& h.state_count > 0 && h.state_count < ( 1ull << 32 )
+			&& h.bucket_count > 0 && h.bucket_count <= h.state_count
+			&& ArrayInFile( h.seeds_offset, h.bucket_count, sizeof(uint32_t) )
+			&& ArrayInFile( h.fingerprints_offset, h.state_count, sizeof(uint16_t) )
+			&& ArrayInFile( h.distances_offset, distance_bytes, 1 )
+			&& ValidDistanceFileVehicles( h );
+		if ( !ok )
+		{
+			Close();
+			out_error = std::string( filename ) + " is not a valid distance table";
+			return false;
+		}
+
+		m_header = &h;
+		m_seeds = (const uint32_t *)( m_data + h.seeds_offset );
+		m_fingerprints = (const uint16_t *)( m_data + h.fingerprints_offset );
+		m_distances = m_data + h.distances_offset;
+		m_unsolvable = h.distance_bits == 4 ? 15 : 255;
+
+		// Set up the vehicles, the same way VehicleTable::Init would
+		m_vehicles.count = h.vehicle_count;
+		m_vehicles.goal = h.goal;
+		m_vehicles.walls = h.walls;
+		for ( int v = 0 ; v < m_vehicles.count ; ++v )
+		{
+			Vehicle &veh = m_vehicles.vehicle[v];
+			veh.label = h.vehicles[v].label;
+			veh.horizontal = h.vehicles[v].horizontal != 0;
+			veh.length = h.vehicles[v].length;
+			veh.can_exit = h.vehicles[v].can_exit != 0;
+			veh.base_mask = h.vehicles[v].base_mask;
+			veh.stride = veh.horizontal ? 1 : BOARD_SIZE;
+			veh.max_offset = veh.length > 1 ? BOARD_SIZE - veh.length : 0;
+		}
+		m_vehicles.PrepareLanes();
+		return true;
+	}
+
+	void Close()
+	{
+		if ( m_data )
+			munmap( (void *)m_data, m_size );
+		m_data = nullptr;
+		m_size = 0;
+		m_header = nullptr;
+	}
+
+	// The vehicles that the table is for
+	const VehicleTable &Vehicles() const { return m_vehicles; }
+
+	// Number of states in the table
+	size_t size() const { return m_header ? m_header->state_count : 0; }
+
+	// Number of moves from a state to the goal, or one of the
+	// DISTANCE_xxx values
+	int Distance( PackedState state ) const
+	{
+		assert( m_header );
+		const uint32_t seed = m_seeds[ DistanceFileBucket( state, m_header->bucket_count ) ];
+		const uint64_t slot = DistanceFileSlot( state, seed, m_header->state_count );
+		if ( m_fingerprints[slot] != DistanceFileFingerprint( state ) )
+			return DISTANCE_NOT_IN_TABLE;
+		int d;
+		if ( m_header->distance_bits == 4 )
+			d = ( m_distances[slot/2] >> ( ( slot & 1 ) * 4 ) ) & 15;
+		else
+			d = m_distances[slot];
+		return d == m_unsolvable ? DISTANCE_UNSOLVABLE : d;
+	}
+
+	// Convert a board into a state of this table
+	bool StateFromBoard( const Board &board, PackedState &out_state ) const
+	{
+		return BoardToTableState( m_vehicles, board, out_state );
+	}
+
+	// Find a move that gets one step closer to the goal.  This is the
+	// hint.  Returns false if the state is already solved, can't be
+	// solved, or isn't in the table.
+	bool NextMove( PackedState state, PackedState &out_next ) const
+	{
+		const int d = Distance( state );
+		if ( d <= 0 )
+			return false;
+		bool found = false;
+		m_vehicles.ForEachMove( state, [&]( PackedState next )
+		{
+			if ( !found && Distance( next ) == d-1 )
+			{
+				out_next = next;
+				found = true;
+			}
+		} );
+		return found;
+	}
+
+	// Find a whole solution from a state by following NextMove, and
+	// put the path from the state to the goal in out_path.  Returns
+	// false if the table can't give a solution we can trust: the
+	// state isn't in the table, or the table says it can't be solved,
+	// or following the distances didn't lead to the goal in the right
+	// number of moves.  (Which happens when the fingerprint of a state
+	// that isn't in the table matches by chance.)
+	bool Solve( PackedState state, std::vector<PackedState> &out_path ) const
+	{
+		out_path.clear();
+		const int d = Distance( state );
+		if ( d < 0 )
+			return false;
+		out_path.push_back( state );
+		PackedState next;
+		while ( (int)out_path.size() <= d && NextMove( out_path.back(), next ) )
+			out_path.push_back( next );
+		if ( (int)out_path.size() != d+1 || !m_vehicles.IsSolved( out_path.back() ) )
+		{
+			out_path.clear();
+			return false;
+		}
+		return true;
+	}
+
+private:
+	const uint8_t *m_data = nullptr;
+	size_t m_size = 0;
+
+	// Pointers into the file
+	const DistanceFileHeader *m_header = nullptr;
+	const uint32_t *m_seeds = nullptr;
+	const uint16_t *m_fingerprints = nullptr;
+	const uint8_t *m_distances = nullptr;
+	int m_unsolvable = 0;
+
+	VehicleTable m_vehicles;
+};
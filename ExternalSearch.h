@@ -0,0 +1,691 @@
+//
+// Breadth-first search with the states on disk
+//
+// The breadth-first search remembers every state it has seen, so that
+// it doesn't explore any of them twice.  For a big enough puzzle, that
+// doesn't fit in memory.  The frontier-only search (see Solver.h) gets
+// by with just the last few layers, but even one layer can be too big.
+//
+// This search keeps the layers in files instead.  The trick that makes
+// this work is "delayed duplicate detection".  We don't check each new
+// state against the states we've seen as we find it, which would mean
+// looking all over a file on disk for every move.  Instead, we just
+// collect all of the states one move away from the current layer,
+// duplicates and all, and then get rid of the duplicates in one go:
+//
+// - Collect the new states in memory until the buffer is full.  Sort
+//   them, remove duplicates, and write them to a file (a "run").
+// - Once the whole layer has been expanded, merge the runs together,
+//   like the last step of a merge sort.  All of the files are sorted,
+//   so reading them from start to end gives us every new state in
+//   order, and a state that appears in several runs comes up several
+//   times in a row.  (If there are too many runs to have them all open
+//   at once, we merge them into fewer, bigger runs first.)
+// - At the same time, read the previous and current layers, which are
+//   also sorted, alongside.  A state that is in either of them isn't
+//   new.  Everything else is the next layer, and it comes out sorted,
+//   ready for next time.
+//
+// Why only the previous and current layers?  Every move can be undone,
+// so a state we reach from a state N moves from the start can only be
+// N-1, N or N+1 moves from the start.  (The same reasoning as the
+// frontier-only search.)  The exception is a vehicle driving out
+// through the exit, which can't be undone.  So we also keep a sorted
+// file of every state with a vehicle missing, and check against that.
+//
+// Every file is only ever read or written from start to end, which
+// is the fastest way to use a disk, and the memory we need is the
+// sort buffer, plus a small buffer for each file.  We keep the layer
+// files until the end, so that we can find the path: starting from
+// the solved state, look for a state in the layer before that leads
+// to it, and so on back to the start.  That's a binary search in each
+// layer file, which only reads a few records.
+//
+
+#pragma once
+
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <string>
+#include <vector>
+
+#include "BitBoard.h"
+#include "ProgressReporter.h"
+
+// Number of records we read or write at a time
+constexpr size_t EXTERNAL_BLOCK_RECORDS = 8192;
+
+// Most runs we merge at once.  Each one is an open file, and the
+// system only lets us have so many (often 1024).  With more runs than
+// this, we merge them in several passes.
+constexpr int EXTERNAL_MAX_MERGE_RUNS = 128;
+
+// Reads a file of fixed-size records from start to end, a block at a
+// time.  The records are plain values, in the byte order of the
+// machine.
+template <typename T>
+class RecordReader
+{
+public:
+	RecordReader() {}
+	~RecordReader() { Close(); }
+	RecordReader( const RecordReader & ) = delete;
+	RecordReader &operator=( const RecordReader & ) = delete;
+
+	// Open the file and read the first block.  Returns false if the
+	// file can't be opened.  The bytes we read are added to
+	// *bytes_read.
+	bool Open( const std::string &filename, uint64_t *bytes_read )
+	{
+		Close();
+		m_file = fopen( filename.c_str(), "rb" );
+		if ( !m_file )
+			return false;
+		m_bytes_read = bytes_read;
+		m_buffer.resize( EXTERNAL_BLOCK_RECORDS );
+		Fill();
+		return true;
+	}
+
+	void Close()
+	{
+		if ( m_file )
+			fclose( m_file );
+		m_file = nullptr;
+		m_pos = m_count = 0;
+	}
+
+	// True when we've read every record (or the file isn't open)
+	bool Done() const { return m_pos == m_count; }
+
+	// The current record, and moving on to the next one
+	const T &Current() const { return m_buffer[m_pos]; }
+	void Next()
+	{
+		if ( ++m_pos == m_count )
+			Fill();
+	}
+
+	// True if a read failed
+	bool Failed() const { return m_failed; }
+
+private:
+	FILE *m_file = nullptr;
+	std::vector<T> m_buffer;
+	size_t m_pos = 0;
+	size_t m_count = 0;
+	bool m_failed = false;
+	uint64_t *m_bytes_read = nullptr;
+
+	void Fill()
+	{
+		m_pos = 0;
+		m_count = fread( m_buffer.data(), sizeof(T), m_buffer.size(), m_file );
+		*m_bytes_read += m_count*sizeof(T);
+		if ( m_count < m_buffer.size() && ferror( m_file ) )
+			m_failed = true;
+	}
+};
+
+// Writes a file of fixed-size records, a block at a time
+template <typename T>
+class RecordWriter
+{
+public:
+	RecordWriter() {}
+	~RecordWriter() { Close(); }
+	RecordWriter( const RecordWriter & ) = delete;
+	RecordWriter &operator=( const RecordWriter & ) = delete;
+
+	// Create the file.  Returns false if it can't be created.  The
+	// bytes we write are added to *bytes_written.
+	bool Open( const std::string &filename, uint64_t *bytes_written )
+	{
+		Close();
+		m_file = fopen( filename.c_str(), "wb" );
+		if ( !m_file )
+			return false;
+		m_bytes_written = bytes_written;
+		m_buffer.reserve( EXTERNAL_BLOCK_RECORDS );
+		m_count = 0;
+		m_failed = false;
+		return true;
+	}
+
+	void Write( const T &x )
+	{
+		m_buffer.push_back( x );
+		++m_count;
+		if ( m_buffer.size() == EXTERNAL_BLOCK_RECORDS )
+			Flush();
+	}
+
+	// Number of records written
+	uint64_t Count() const { return m_count; }
+
+	// Write what's left and close the file.  Returns false if
+	// anything went wrong since the file was opened.
+	bool Close()
+	{
+		if ( !m_file )
+			return !m_failed;
+		Flush();
+		if ( fclose( m_file ) != 0 )
+			m_failed = true;
+		m_file = nullptr;
+		return !m_failed;
+	}
+
+private:
+	FILE *m_file = nullptr;
+	std::vector<T> m_buffer;
+	uint64_t m_count = 0;
+	bool m_failed = false;
+	uint64_t *m_bytes_written = nullptr;
+
+	void Flush()
+	{
+		if ( m_buffer.empty() )
+			return;
+		if ( fwrite( m_buffer.data(), sizeof(T), m_buffer.size(), m_file ) != m_buffer.size() )
+			m_failed = true;
+		*m_bytes_written += m_buffer.size()*sizeof(T);
+		m_buffer.clear();
+	}
+};
+
+// Result of an external-memory search
+template <typename TPackedState>
+struct ExternalSearchResult
+{
+	// States along the solution, from the initial state to the solved
+	// state.  Empty if there is no solution.
+	std::vector<TPackedState> path;
+
+	// Why the search couldn't finish, if it couldn't (for example,
+	// the disk is full).  Empty if it did.
+	std::string error;
+
+	// The usual counts, the same as for the breadth-first search
+	uint64_t states_discovered = 0;
+	uint64_t states_expanded = 0;
+	uint64_t states_generated = 0;
+
+	// How much we read from and wrote to disk
+	uint64_t bytes_read = 0;
+	uint64_t bytes_written = 0;
+};
+
+// One external-memory breadth-first search.  The files go in a new
+// directory inside the one we're given, so several searches can share
+// it, and they are all removed when the search is destroyed.
+template <typename TVehicleTable>
+class ExternalSearch
+{
+public:
+	typedef typename TVehicleTable::PackedState PackedState;
+	typedef ExternalSearchResult<PackedState> Result;
+
+	// memory_bytes is the size of the buffer for sorting new states.
+	// If progress isn't null, we keep it up to date as we go.
+	ExternalSearch( const TVehicleTable &vehicles, const std::string &dir, size_t memory_bytes, bool verbose, SearchProgress *progress )
+	: m_vehicles( vehicles ), m_dir( dir ), m_verbose( verbose ), m_progress( progress )
+	{
+		m_buffer_capacity = std::max( memory_bytes / sizeof(PackedState), size_t( TVehicleTable::MAX_MOVES_PER_STATE*16 ) );
+	}
+
+	~ExternalSearch()
+	{
+		RemoveFiles();
+	}
+
+	// Search for the shortest solution from the initial state.  This
+	// is the same search as the serial breadth-first search, and finds
+	// a path of the same length, but perhaps not the same path.
+	Result Search( PackedState initial_state )
+	{
+		RemoveFiles();
+		m_result = Result();
+		m_layer_sizes.clear();
+		m_max_runs = 0;
+		if ( !CreateWorkDir() )
+			return m_result;
+
+		// Layer 0 is just the initial state.  We start with an empty
+		// file of states with a vehicle missing.
+		{
+			RecordWriter<PackedState> layer, exited;
+			if ( !layer.Open( LayerFile( 0 ), &m_result.bytes_written ) || !exited.Open( ExitedFile( 0 ), &m_result.bytes_written ) )
+				return Fail( "Can't create files in " + m_work_dir );
+			layer.Write( initial_state );
+			if ( !layer.Close() || !exited.Close() )
+				return Fail( "Can't write to " + m_work_dir );
+		}
+		m_layer_sizes.push_back( 1 );
+		m_result.states_discovered = 1;
+		if ( m_vehicles.IsSolved( initial_state ) )
+		{
+			m_result.path.push_back( initial_state );
+			return m_result;
+		}
+
+		for ( int depth = 0 ; m_layer_sizes[depth] > 0 ; ++depth )
+		{
+			if ( m_progress )
+				m_progress->SetLayer( depth, m_layer_sizes[depth] );
+
+			int num_runs = 0;
+			bool found = false;
+			PackedState solved = 0;
+			if ( !ExpandLayer( depth, num_runs, found, solved ) )
+				return m_result;
+			if ( found )
+			{
+				m_result.states_discovered += 1;
+				TracePath( depth+1, solved );
+				return m_result;
+			}
+			if ( !MergeRuns( depth, num_runs ) )
+				return m_result;
+			m_result.states_discovered += m_layer_sizes[depth+1];
+			if ( m_progress )
+				m_progress->SetStates( m_result.states_discovered );
+			if ( m_verbose )
+			{
+				printf( "...depth %d, %llu states, sorted in %d runs\n", depth+1,
+					(unsigned long long)m_layer_sizes[depth+1], num_runs );
+			}
+		}
+
+		// Ran out of new states without finding a solution
+		return m_result;
+	}
+
+private:
+
+	const TVehicleTable &m_vehicles;
+	std::string m_dir;
+	std::string m_work_dir;
+	bool m_verbose;
+	SearchProgress *m_progress;
+	size_t m_buffer_capacity;
+
+	Result m_result;
+
+	// Number of states in each layer we've written
+	std::vector<uint64_t> m_layer_sizes;
+
+	// New states waiting to be sorted and written as a run
+	std::vector<PackedState> m_buffer;
+
+	// Most runs we've had at once, so we know which files to remove
+	int m_max_runs = 0;
+
+	std::string LayerFile( int depth ) const { return m_work_dir + "/layer-" + std::to_string( depth ); }
+	std::string RunFile( int run ) const { return m_work_dir + "/run-" + std::to_string( run ); }
+
+	// We only need the file of exited states from the last layer, and
+	// the one we're writing for the next, so we alternate between two
+	std::string ExitedFile( int depth ) const { return m_work_dir + "/exited-" + std::to_string( depth & 1 ); }
+
+	Result &Fail( const std::string &error )
+	{
+		m_result.error = error;
+		m_result.path.clear();
+		return m_result;
+	}
+
+	bool CreateWorkDir()
+	{
+		m_work_dir = m_dir + "/rushhour-XXXXXX";
+		if ( !mkdtemp( &m_work_dir[0] ) )
+		{
+			Fail( "Can't create a directory in " + m_dir );
+			m_work_dir.clear();
+			return false;
+		}
+		return true;
+	}
+
+	void RemoveFiles()
+	{
+		if ( m_work_dir.empty() )
+			return;
+		for ( int depth = 0 ; depth <= (int)m_layer_sizes.size() ; ++depth )
+			unlink( LayerFile( depth ).c_str() );
+		for ( int run = 0 ; run < m_max_runs ; ++run )
+			unlink( RunFile( run ).c_str() );
+		unlink( ExitedFile( 0 ).c_str() );
+		unlink( ExitedFile( 1 ).c_str() );
+		rmdir( m_work_dir.c_str() );
+		m_work_dir.clear();
+	}
+
+	// Sort the buffer, and write it out as a run
+	bool WriteRun( int run )
+	{
+		m_max_runs = std::max( m_max_runs, run+1 );
+		std::sort( m_buffer.begin(), m_buffer.end() );
+		RecordWriter<PackedState> writer;
+		if ( !writer.Open( RunFile( run ), &m_result.bytes_written ) )
+			return false;
+		for ( size_t i = 0 ; i < m_buffer.size() ; ++i )
+		{
+			if ( i == 0 || m_buffer[i] != m_buffer[i-1] )
+				writer.Write( m_buffer[i] );
+		}
+		m_buffer.clear();
+		return writer.Close();
+	}
+
+	// Generate all of the moves from the states in a layer, and write
+	// them out in sorted runs.  If we find a solved state, we stop
+	// there, and set out_found.
+	bool ExpandLayer( int depth, int &out_num_runs, bool &out_found, PackedState &out_solved )
+	{
+		RecordReader<PackedState> layer;
+		if ( !layer.Open( LayerFile( depth ), &m_result.bytes_read ) )
+		{
+			Fail( "Can't read " + LayerFile( depth ) );
+			return false;
+		}
+		m_buffer.reserve( m_buffer_capacity );
+		m_buffer.clear();
+		out_num_runs = 0;
+		out_found = false;
+		for ( ; !layer.Done() && !out_found ; layer.Next() )
+		{
+			++m_result.states_expanded;
+			m_vehicles.ForEachMove( layer.Current(), [&]( PackedState next )
+			{
+				++m_result.states_generated;
+				if ( out_found )
+					return;
+
+				// Nothing before this layer was solved, so this
+				// must be a new state
+				if ( m_vehicles.IsSolved( next ) )
+				{
+					out_found = true;
+					out_solved = next;
+					return;
+				}
+				m_buffer.push_back( next );
+			} );
+
+			// Make sure there's room for all of the moves from the
+			// next state
+			if ( m_buffer.size() + TVehicleTable::MAX_MOVES_PER_STATE > m_buffer_capacity )
+			{
+				if ( !WriteRun( out_num_runs++ ) )
+				{
+					Fail( "Can't write " + RunFile( out_num_runs-1 ) );
+					return false;
+				}
+			}
+		}
+		if ( layer.Failed() )
+		{
+			Fail( "Can't read " + LayerFile( depth ) );
+			return false;
+		}
+		if ( !out_found && !m_buffer.empty() && !WriteRun( out_num_runs++ ) )
+		{
+			Fail( "Can't write " + RunFile( out_num_runs-1 ) );
+			return false;
+		}
+		return true;
+	}
+
+	// Reads a set of runs at once, giving back every state in them in
+	// order, each one once.  The smallest state at the front of any run
+	// comes out first, so we keep the runs in a heap ordered by that.
+	class RunMerger
+	{
+	public:
+		// Open the runs.  Returns false if one can't be opened.
+		bool Open( const std::vector<std::string> &filenames, uint64_t *bytes_read )
+		{
+			for ( const std::string &filename: filenames )
+			{
+				m_runs.emplace_back( new RecordReader<PackedState>() );
+				if ( !m_runs.back()->Open( filename, bytes_read ) )
+					return false;
+				if ( !m_runs.back()->Done() )
+					m_heap.push( HeapEntry( m_runs.back()->Current(), (int)m_runs.size()-1 ) );
+			}
+			return true;
+		}
+
+		bool Done() const { return m_heap.empty(); }
+		PackedState Current() const { return m_heap.top().first; }
+
+		// Move on to the next state that is bigger than this one,
+		// skipping the copies of it in the other runs
+		void Next()
+		{
+			const PackedState state = Current();
+			while ( !m_heap.empty() && m_heap.top().first == state )
+			{
+				const int idx_run = m_heap.top().second;
+				m_heap.pop();
+				RecordReader<PackedState> &run = *m_runs[idx_run];
+				run.Next();
+				if ( !run.Done() )
+					m_heap.push( HeapEntry( run.Current(), idx_run ) );
+			}
+		}
+
+		// True if a read failed
+		bool Failed() const
+		{
+			for ( const auto &run: m_runs )
+			{
+				if ( run->Failed() )
+					return true;
+			}
+			return false;
+		}
+
+	private:
+		typedef std::pair<PackedState,int> HeapEntry;
+		std::vector< std::unique_ptr< RecordReader<PackedState> > > m_runs;
+		std::priority_queue< HeapEntry, std::vector<HeapEntry>, std::greater<HeapEntry> > m_heap;
+	};
+
+	// Merge some of the runs into one new run, and remove them
+	bool MergeIntoRun( const std::vector<int> &runs, int new_run )
+	{
+		m_max_runs = std::max( m_max_runs, new_run+1 );
+		std::vector<std::string> filenames;
+		for ( int run: runs )
+			filenames.push_back( RunFile( run ) );
+		RunMerger merger;
+		RecordWriter<PackedState> writer;
+		if ( !merger.Open( filenames, &m_result.bytes_read ) || !writer.Open( RunFile( new_run ), &m_result.bytes_written ) )
+		{
+			Fail( "Can't merge the runs in " + m_work_dir );
+			return false;
+		}
+		for ( ; !merger.Done() ; merger.Next() )
+			writer.Write( merger.Current() );
+		const bool ok = !merger.Failed() && writer.Close();
+		for ( const std::string &filename: filenames )
+			unlink( filename.c_str() );
+		if ( !ok )
+			Fail( "Can't merge the runs in " + m_work_dir );
+		return ok;
+	}
+
+	// Merge the runs into the next layer, leaving out the states that
+	// are in the previous or current layer, or that have a vehicle
+	// missing and we've seen before.  At the same time, we write the
+	// new file of states with a vehicle missing, adding the new ones.
+	bool MergeRuns( int depth, int num_runs )
+	{
+		// Every run we merge at once is an open file, and there's a
+		// limit on those.  If there are too many runs, merge them in
+		// groups into bigger runs first, as many times as it takes.
+		std::vector<int> runs;
+		for ( int run = 0 ; run < num_runs ; ++run )
+			runs.push_back( run );
+		int next_run = num_runs;
+		while ( (int)runs.size() > EXTERNAL_MAX_MERGE_RUNS )
+		{
+			std::vector<int> merged;
+			for ( size_t first = 0 ; first < runs.size() ; first += EXTERNAL_MAX_MERGE_RUNS )
+			{
+				const size_t last = std::min( first + EXTERNAL_MAX_MERGE_RUNS, runs.size() );
+				if ( last - first == 1 )
+				{
+					merged.push_back( runs[first] );
+					continue;
+				}
+				if ( !MergeIntoRun( std::vector<int>( runs.begin() + first, runs.begin() + last ), next_run ) )
+					return false;
+				merged.push_back( next_run++ );
+			}
+			runs.swap( merged );
+		}
+
+		std::vector<std::string> run_files;
+		for ( int run: runs )
+			run_files.push_back( RunFile( run ) );
+		RunMerger merger;
+		if ( !merger.Open( run_files, &m_result.bytes_read ) )
+		{
+			Fail( "Can't read the runs in " + m_work_dir );
+			return false;
+		}
+		RecordReader<PackedState> prev, cur, exited;
+		if ( ( depth > 0 && !prev.Open( LayerFile( depth-1 ), &m_result.bytes_read ) )
+			|| !cur.Open( LayerFile( depth ), &m_result.bytes_read )
+			|| !exited.Open( ExitedFile( depth ), &m_result.bytes_read ) )
+		{
+			Fail( "Can't read the files in " + m_work_dir );
+			return false;
+		}
+		RecordWriter<PackedState> next, next_exited;
+		if ( !next.Open( LayerFile( depth+1 ), &m_result.bytes_written )
+			|| !next_exited.Open( ExitedFile( depth+1 ), &m_result.bytes_written ) )
+		{
+			Fail( "Can't create files in " + m_work_dir );
+			return false;
+		}
+
+		// Move a reader past everything smaller than x, and check
+		// whether the next thing is x
+		auto SkipTo = []( RecordReader<PackedState> &reader, PackedState x )
+		{
+			while ( !reader.Done() && reader.Current() < x )
+				reader.Next();
+			return !reader.Done() && reader.Current() == x;
+		};
+
+		for ( ; !merger.Done() ; merger.Next() )
+		{
+			const PackedState state = merger.Current();
+
+			// Copy the states with a vehicle missing that come before
+			// this one across to the new file
+			while ( !exited.Done() && exited.Current() < state )
+			{
+				next_exited.Write( exited.Current() );
+				exited.Next();
+			}
+			const bool seen = ( !exited.Done() && exited.Current() == state )
+				|| SkipTo( cur, state )
+				|| ( depth > 0 && SkipTo( prev, state ) );
+			if ( seen )
+				continue;
+			next.Write( state );
+			if ( TVehicleTable::HasExitedVehicle( state ) )
+				next_exited.Write( state );
+		}
+		for ( ; !exited.Done() ; exited.Next() )
+			next_exited.Write( exited.Current() );
+
+		const bool ok = !prev.Failed() && !cur.Failed() && !exited.Failed() && !merger.Failed();
+		for ( const std::string &filename: run_files )
+			unlink( filename.c_str() );
+		if ( !ok )
+		{
+			Fail( "Can't read the files in " + m_work_dir );
+			return false;
+		}
+		if ( !next.Close() || !next_exited.Close() )
+		{
+			Fail( "Can't write to " + m_work_dir );
+			return false;
+		}
+		m_layer_sizes.push_back( next.Count() );
+
+		// We don't need the layer before the previous one to find
+		// duplicates any more, but we keep it to find the path
+		return true;
+	}
+
+	// Check if a state is in a layer file, with a binary search
+	bool LayerContains( int fd, uint64_t count, PackedState state )
+	{
+		uint64_t lo = 0, hi = count;
+		while ( lo < hi )
+		{
+			const uint64_t mid = lo + ( hi - lo ) / 2;
+			PackedState x;
+			if ( pread( fd, &x, sizeof(x), off_t( mid*sizeof(x) ) ) != (ssize_t)sizeof(x) )
+				return false;
+			m_result.bytes_read += sizeof(x);
+			if ( x == state )
+				return true;
+			if ( x < state )
+				lo = mid+1;
+			else
+				hi = mid;
+		}
+		return false;
+	}
+
+	// Find the path back from a solved state at the given depth.  Each
+	// state on the path must have come from a state in the layer
+	// before, so try each state that leads to it, until we find one
+	// that is in that layer.
+	void TracePath( int depth, PackedState solved )
+	{
+		std::vector<PackedState> &path = m_result.path;
+		path.assign( depth+1, solved );
+		for ( int d = depth-1 ; d >= 0 ; --d )
+		{
+			const int fd = open( LayerFile( d ).c_str(), O_RDONLY );
+			if ( fd < 0 )
+			{
+				Fail( "Can't read " + LayerFile( d ) );
+				return;
+			}
+			bool found = false;
+			m_vehicles.ForEachReverseMove( path[d+1], [&]( PackedState prev )
+			{
+				if ( !found && LayerContains( fd, m_layer_sizes[d], prev ) )
+				{
+					path[d] = prev;
+					found = true;
+				}
+			} );
+			close( fd );
+			if ( !found )
+			{
+				Fail( "Lost the path at depth " + std::to_string( d ) );
+				return;
+			}
+		}
+	}
+};
@@ -0,0 +1,635 @@
+//
+// Generator for hard Rush Hour puzzles.
+//
+// Build with:
+//
+//    g++ -O2 -pthread -o Generator Generator.cpp
+//
+// Rather than making up boards and checking how hard they are, we
+// look at every possible "layout": a choice of vehicles, and the row
+// or column that each one slides along.  The positions of the
+// vehicles along their tracks are the states of the puzzle.  We find
+// all of the states of a layout, split them up into groups that can
+// be reached from each other (the "connected components"), and work
+// out how many moves each state is from the goal.  The hardest puzzle
+// in a component is the state that is furthest from the goal.
+//
+// There are a lot of layouts, so this can take hours.  The work is
+// shared out among all the cores, and with --checkpoint, we save our
+// progress every so often, so that an interrupted run can be picked
+// up again with --resume.
+//
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "BitBoard.h"
+#include "SolutionCache.h"
+#include "ThreadPool.h"
+
+// Current time, in seconds
+static double Now()
+{
+	using namespace std::chrono;
+	return duration<double>( steady_clock::now().time_since_epoch() ).count();
+}
+
+// A place where a vehicle can go: which way it moves, which row or
+// column it moves along, and how long it is.
+struct Slot
+{
+	bool horizontal;
+	int track;
+	int length;
+};
+
+// All of the slots.  The goal car always has the exit row to itself,
+// as far as horizontal vehicles go.  (Another car in the exit row would
+// either be stuck behind the goal car forever, or just drive out through
+// the exit, so it doesn't make for an interesting puzzle.)
+static std::vector<Slot> MakeSlots()
+{
+	std::vector<Slot> slots;
+	for ( int horizontal = 1 ; horizontal >= 0 ; --horizontal )
+	{
+		for ( int track = 0 ; track < BOARD_SIZE ; ++track )
+		{
+			if ( horizontal && track == BOARD_EXIT_Y )
+				continue;
+			for ( int length = 2 ; length <= 3 ; ++length )
+				slots.push_back( Slot{ horizontal != 0, track, length } );
+		}
+	}
+	return slots;
+}
+
+// Steps through all of the layouts with a given number of vehicles
+// (not counting the goal car).  A layout is a list of slot numbers,
+// in increasing order.  The same slot can be used more than once, for
+// example two cars in the same row.  Always produces the layouts in
+// the same order, so we can pick up where we left off.
+class LayoutEnumerator
+{
+public:
+	LayoutEnumerator( int num_slots, int num_vehicles )
+	: m_num_slots( num_slots ), m_layout( num_vehicles, 0 )
+	{
+	}
+
+	// Get the next layout.  Returns false when there are no more.
+	bool Next( std::vector<int> &out_layout )
+	{
+		if ( m_done )
+			return false;
+		if ( m_started )
+		{
+			// Find the last slot number we can still increase, increase
+			// it, and set everything after it to the same slot
+			int i = (int)m_layout.size()-1;
+			while ( i >= 0 && m_layout[i] == m_num_slots-1 )
+				--i;
+			if ( i < 0 )
+			{
+				m_done = true;
+				return false;
+			}
+			++m_layout[i];
+			for ( int j = i+1 ; j < (int)m_layout.size() ; ++j )
+				m_layout[j] = m_layout[i];
+		}
+		m_started = true;
+		out_layout = m_layout;
+		return true;
+	}
+
+private:
+	int m_num_slots;
+	std::vector<int> m_layout;
+	bool m_started = false;
+	bool m_done = false;
+};
+
+// What we found out about the hardest component of a layout
+struct ComponentReport
+{
+	// Moves needed from the hardest state
+	int moves = -1;
+
+	// The first hardest state we found
+	PackedState hardest = 0;
+
+	// Number of states in the component
+	uint64_t size = 0;
+
+	// Number of states in the component that need that many moves
+	uint64_t hardest_count = 0;
+
+	// Number of different shortest solutions from the hardest state
+	uint64_t solutions = 0;
+};
+
+// Finds the hardest puzzle in a layout.  Each thread has its own,
+// so the tables are reused from one layout to the next.
+class LayoutAnalyzer
+{
+public:
+
+	explicit LayoutAnalyzer( MoveMetric metric )
+	{
+		m_vehicles.metric = metric;
+	}
+
+	// Set up the vehicles for a layout.  Returns false if they
+	// obviously can't fit on the board.
+	bool SetLayout( const std::vector<Slot> &slots, const std::vector<int> &layout )
+	{
+		if ( layout.size()+1 > MAX_VEHICLES )
+			return false;
+
+		// Make sure each row and column isn't overfull
+		int used[2][BOARD_SIZE] = {};
+		used[1][BOARD_EXIT_Y] = 2;
+		for ( int s: layout )
+		{
+			used[ slots[s].horizontal ][ slots[s].track ] += slots[s].length;
+			if ( used[ slots[s].horizontal ][ slots[s].track ] > BOARD_SIZE )
+				return false;
+		}
+
+		// Vehicle 0 is the goal car.  The rest are in slot order, so
+		// vehicles in the same slot are next to each other.
+		m_vehicles.count = 0;
+		m_vehicles.goal = 0;
+		AddVehicle( 'X', Slot{ true, BOARD_EXIT_Y, 2 } );
+		for ( int i = 0 ; i < (int)layout.size() ; ++i )
+			AddVehicle( CANONICAL_LABELS[i], slots[ layout[i] ] );
+		m_layout = layout;
+		m_vehicles.PrepareLanes();
+		return true;
+	}
+
+	// Find the hardest component of the current layout.  Returns false
+	// if none of the states can be solved.
+	bool Analyze( ComponentReport &out_best )
+	{
+		// Find every way to put the vehicles on the board
+		m_states.clear();
+		m_index.Clear();
+		PlaceVehicles( 0, 0, 0 );
+		const int num_states = (int)m_states.size();
+
+		// Distance from each state to the goal, by searching backward
+		// from all of the solved states at once
+		m_distance.assign( num_states, -1 );
+		m_queue.clear();
+		for ( int i = 0 ; i < num_states ; ++i )
+		{
+			if ( m_vehicles.IsSolved( m_states[i] ) )
+			{
+				m_distance[i] = 0;
+				m_queue.push_back( i );
+			}
+		}
+		for ( size_t q = 0 ; q < m_queue.size() ; ++q )
+		{
+			const int cur = m_queue[q];
+			m_vehicles.ForEachReverseMove( m_states[cur], [&]( PackedState prev )
+			{
+				const int i = IndexOf( prev );
+				if ( m_distance[i] < 0 )
+				{
+					m_distance[i] = m_distance[cur] + 1;
+					m_queue.push_back( i );
+				}
+			} );
+		}
+
+		// Split the states into components.  No vehicle can leave the
+		// board, so every move can be undone, and everything we can
+		// reach from a state is in the same component as it.  So a
+		// plain search from any state finds its whole component.  Then
+		// either every state in the component can be solved, or none can.
+		m_component.assign( num_states, -1 );
+		bool found = false;
+		for ( int start = 0 ; start < num_states ; ++start )
+		{
+			if ( m_component[start] >= 0 )
+				continue;
+			m_queue.clear();
+			m_queue.push_back( start );
+			m_component[start] = start;
+			ComponentReport report;
+			for ( size_t q = 0 ; q < m_queue.size() ; ++q )
+			{
+				const int cur = m_queue[q];
+				if ( m_distance[cur] > report.moves )
+				{
+					report.moves = m_distance[cur];
+					report.hardest = m_states[cur];
+					report.hardest_count = 0;
+				}
+				if ( m_distance[cur] == report.moves )
+					++report.hardest_count;
+				m_vehicles.ForEachMove( m_states[cur], [&]( PackedState next )
+				{
+					const int i = IndexOf( next );
+					if ( m_component[i] < 0 )
+					{
+						m_component[i] = start;
+						m_queue.push_back( i );
+					}
+				} );
+			}
+			report.size = m_queue.size();
+			if ( report.moves < 0 )
+				continue;
+
+			// Keep the hardest.  If there's a tie, keep the bigger one.
+			if ( !found || report.moves > out_best.moves || ( report.moves == out_best.moves && report.size > out_best.size ) )
+			{
+				report.solutions = CountShortestSolutions( m_queue, IndexOf( report.hardest ) );
+				out_best = report;
+				found = true;
+			}
+		}
+		return found;
+	}
+
+	const VehicleTable &Vehicles() const { return m_vehicles; }
+
+private:
+
+	VehicleTable m_vehicles;
+	std::vector<int> m_layout;
+
+	// All of the states of the layout, and where each one is in the list
+	std::vector<PackedState> m_states;
+	HashSet<IndexedState> m_index;
+
+	// For each state, the moves to the goal (-1 if it can't be solved),
+	// and the first state of its component
+	std::vector<int> m_distance;
+	std::vector<int> m_component;
+
+	// Work space
+	std::vector<int> m_queue;
+	std::vector<uint64_t> m_solutions;
+	std::vector<int> m_order;
+
+	void AddVehicle( char label, const Slot &slot )
+	{
+		Vehicle &veh = m_vehicles.vehicle[ m_vehicles.count++ ];
+		veh.label = label;
+		veh.horizontal = slot.horizontal;
+		veh.length = slot.length;
+		veh.can_exit = false;
+		veh.stride = slot.horizontal ? 1 : BOARD_SIZE;
+		veh.max_offset = BOARD_SIZE - slot.length;
+		veh.base_mask = 0;
+		for ( int i = 0 ; i < slot.length ; ++i )
+			veh.base_mask |= slot.horizontal ? CellBit( slot.track, i ) : CellBit( i, slot.track );
+	}
+
+	// Try every position for vehicle v, and then the ones after it.
+	// Vehicles in the same slot look the same, so swapping two of
+	// them gives the same board.  To only find each board once, we
+	// keep them in order along the track.
+	void PlaceVehicles( int v, PackedState state, uint64_t occupied )
+	{
+		if ( v == m_vehicles.count )
+		{
+			m_index.Insert( IndexedState{ state, (int)m_states.size() } );
+			m_states.push_back( state );
+			return;
+		}
+		const Vehicle &veh = m_vehicles.vehicle[v];
+		int first = 0;
+		if ( v > 1 && m_layout[v-1] == m_layout[v-2] )
+			first = VehicleTable::Offset( state, v-1 ) + veh.length;
+		for ( int offset = first ; offset <= veh.max_offset ; ++offset )
+		{
+			const uint64_t m = veh.Mask( offset );
+			if ( !( m & occupied ) )
+				PlaceVehicles( v+1, state | PackedState( offset ) << ( v*OFFSET_BITS ), occupied | m );
+		}
+	}
+
+	int IndexOf( PackedState state ) const
+	{
+		const IndexedState *s = m_index.Find( IndexedState{ state, -1 } );
+		assert( s );
+		return s->index;
+	}
+
+	// Count the different shortest solutions from a state, given all
+	// of the states of its component.  The number of shortest solutions
+	// from a state is the total for all of the moves that take it one
+	// step closer to the goal, so we work outward from the goal.  The
+	// count can get very big, so it stops at the largest number we
+	// can store.
+	uint64_t CountShortestSolutions( const std::vector<int> &component, int from )
+	{
+		m_order = component;
+		std::sort( m_order.begin(), m_order.end(), [&]( int a, int b ) { return m_distance[a] < m_distance[b]; } );
+		m_solutions.assign( m_states.size(), 0 );
+		for ( int i: m_order )
+		{
+			if ( m_distance[i] == 0 )
+			{
+				m_solutions[i] = 1;
+				continue;
+			}
+			uint64_t total = 0;
+			m_vehicles.ForEachMove( m_states[i], [&]( PackedState next )
+			{
+				const int n = IndexOf( next );
+				if ( m_distance[n] == m_distance[i]-1 )
+					total = total > ~0ull - m_solutions[n] ? ~0ull : total + m_solutions[n];
+			} );
+			m_solutions[i] = total;
+			if ( i == from )
+				break;
+		}
+		return m_solutions[from];
+	}
+};
+
+// Write a board as one line of text, the way RushHourSolver --board
+// reads it.  We put it in canonical form first, so the labels don't
+// depend on how we happened to number the vehicles.
+static std::string BoardToLine( const Board &board )
+{
+	CanonicalBoard canonical;
+	const Board &b = CanonicalizeBoard( board, canonical ) ? canonical.board : board;
+	std::string line;
+	for ( int y = 0 ; y < BOARD_SIZE ; ++y )
+	{
+		for ( int x = 0 ; x < BOARD_SIZE ; ++x )
+			line.push_back( b.cell[y][x] == ' ' ? '.' : b.cell[y][x] );
+	}
+	return line;
+}
+
+// Settings for a run.  These are saved in the checkpoint, so that
+// we only resume a run with the same settings.
+struct GeneratorOptions
+{
+	int num_vehicles = 0;
+	MoveMetric metric = MoveMetric::Square;
+	int min_moves = 0;
+};
+
+// Save our progress.  The output file has the results for all of the
+// layouts before next_layout, and nothing else, as long as we cut it
+// back to output_size.  We write a new file and then rename it over
+// the old one, so that if we're interrupted while writing, we still
+// have the old checkpoint.
+static bool WriteCheckpoint( const char *filename, const GeneratorOptions &options, uint64_t next_layout, long output_size )
+{
+	const std::string temp_filename = std::string( filename ) + ".tmp";
+	FILE *f = fopen( temp_filename.c_str(), "w" );
+	if ( !f )
+		return false;
+	fprintf( f, "rushhour-generator-checkpoint 1\n" );
+	fprintf( f, "vehicles %d\n", options.num_vehicles );
+	fprintf( f, "metric %s\n", options.metric == MoveMetric::Slide ? "slide" : "square" );
+	fprintf( f, "min_moves %d\n", options.min_moves );
+	fprintf( f, "next_layout %llu\n", (unsigned long long)next_layout );
+	fprintf( f, "output_size %ld\n", output_size );
+	bool ok = fflush( f ) == 0 && fsync( fileno( f ) ) == 0;
+	ok = ( fclose( f ) == 0 ) && ok;
+	return ok && rename( temp_filename.c_str(), filename ) == 0;
+}
+
+// Read a checkpoint written by WriteCheckpoint.  Returns false if it
+// can't be read, or was made with different settings.
+static bool ReadCheckpoint( const char *filename, const GeneratorOptions &options, uint64_t &out_next_layout, long &out_output_size )
+{
+	FILE *f = fopen( filename, "r" );
+	if ( !f )
+	{
+		fprintf( stderr, "Can't open %s\n", filename );
+		return false;
+	}
+	int version = 0, num_vehicles = -1, min_moves = -1;
+	char metric[16] = "";
+	unsigned long long next_layout = 0;
+	const int fields = fscanf( f, "rushhour-generator-checkpoint %d vehicles %d metric %15s min_moves %d next_layout %llu output_size %ld",
+		&version, &num_vehicles, metric, &min_moves, &next_layout, &out_output_size );
+	fclose( f );
+	if ( fields != 6 || version != 1 )
+	{
+		fprintf( stderr, "%s is not a generator checkpoint\n", filename );
+		return false;
+	}
+	if ( num_vehicles != options.num_vehicles || min_moves != options.min_moves
+		|| strcmp( metric, options.metric == MoveMetric::Slide ? "slide" : "square" ) )
+	{
+		fprintf( stderr, "%s was made with different settings (--vehicles %d --min-moves %d, %s metric)\n",
+			filename, num_vehicles, min_moves, metric );
+		return false;
+	}
+	out_next_layout = next_layout;
+	return true;
+}
+
+static void PrintUsage( const char *argv0 )
+{
+	fprintf( stderr, "Usage: %s --vehicles N --output FILE [--min-moves N] [--slide] [--threads N]\n", argv0 );
+	fprintf( stderr, "          [--checkpoint FILE [--interval SECONDS]] [--resume] [--limit N]\n" );
+	fprintf( stderr, "  --vehicles N      Number of vehicles, not counting the goal car (1-%d)\n", MAX_VEHICLES-1 );
+	fprintf( stderr, "  --output FILE     Where to write the puzzles we find\n" );
+	fprintf( stderr, "  --min-moves N     Only report puzzles that need at least N moves\n" );
+	fprintf( stderr, "  --slide           Count sliding a car any number of squares as one move\n" );
+	fprintf( stderr, "  --threads N       Number of threads (default one per core)\n" );
+	fprintf( stderr, "  --checkpoint FILE Save progress to FILE every --interval seconds (default 60)\n" );
+	fprintf( stderr, "  --resume          Carry on from the checkpoint, appending to the output\n" );
+	fprintf( stderr, "  --limit N         Stop after looking at N more layouts\n" );
+}
+
+int main( int argc, char **argv )
+{
+	GeneratorOptions options;
+	const char *output_filename = nullptr;
+	const char *checkpoint_filename = nullptr;
+	double checkpoint_interval = 60.0;
+	bool resume = false;
+	int num_threads = 0;
+	uint64_t limit = ~0ull;
+	for ( int i = 1 ; i < argc ; ++i )
+	{
+		if ( !strcmp( argv[i], "--vehicles" ) && i+1 < argc )
+			options.num_vehicles = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--output" ) && i+1 < argc )
+			output_filename = argv[++i];
+		else if ( !strcmp( argv[i], "--min-moves" ) && i+1 < argc )
+			options.min_moves = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--slide" ) )
+			options.metric = MoveMetric::Slide;
+		else if ( !strcmp( argv[i], "--threads" ) && i+1 < argc )
+			num_threads = atoi( argv[++i] );
+		else if ( !strcmp( argv[i], "--checkpoint" ) && i+1 < argc )
+			checkpoint_filename = argv[++i];
+		else if ( !strcmp( argv[i], "--interval" ) && i+1 < argc )
+			checkpoint_interval = atof( argv[++i] );
+		else if ( !strcmp( argv[i], "--resume" ) )
+			resume = true;
+		else if ( !strcmp( argv[i], "--limit" ) && i+1 < argc )
+			limit = strtoull( argv[++i], nullptr, 10 );
+		else
+		{
+			PrintUsage( argv[0] );
+			return 1;
+		}
+	}
+	if ( options.num_vehicles < 1 || options.num_vehicles > MAX_VEHICLES-1 || !output_filename || ( resume && !checkpoint_filename ) )
+	{
+		PrintUsage( argv[0] );
+		return 1;
+	}
+
+	// Start a new output file, or pick up where we left off.  Anything
+	// in the output after the checkpoint was written is for layouts
+	// that we're going to do again, so throw it away.
+	uint64_t first_layout = 0;
+	FILE *output = nullptr;
+	if ( resume )
+	{
+		long output_size = 0;
+		if ( !ReadCheckpoint( checkpoint_filename, options, first_layout, output_size ) )
+			return 1;
+		output = fopen( output_filename, "r+" );
+		if ( !output || ftruncate( fileno( output ), output_size ) != 0 || fseek( output, 0, SEEK_END ) != 0 )
+		{
+			fprintf( stderr, "Can't reopen %s\n", output_filename );
+			return 1;
+		}
+		fprintf( stderr, "Resuming at layout %llu\n", (unsigned long long)first_layout );
+	}
+	else
+	{
+		output = fopen( output_filename, "w" );
+		if ( !output )
+		{
+			fprintf( stderr, "Can't create %s\n", output_filename );
+			return 1;
+		}
+		// The moves are counted the way RushHourSolver counts them (the
+		// moves column of --batch): up to the red car reaching the exit.
+		// The solution it prints has one more step, since the steps are
+		// the boards along the way, starting with the initial one.
+		fprintf( output, "# moves board component_size hardest_states shortest_solutions\n" );
+		fprintf( output, "# moves = moves until X reaches the exit, as in RushHourSolver --batch (its printed solution has moves+1 steps, counting the initial board)\n" );
+	}
+
+	// Skip the layouts we've already done
+	const std::vector<Slot> slots = MakeSlots();
+	LayoutEnumerator layouts( (int)slots.size(), options.num_vehicles );
+	std::vector<int> layout;
+	for ( uint64_t i = 0 ; i < first_layout ; ++i )
+		layouts.Next( layout );
+
+	ThreadPool pool( num_threads );
+	std::vector< std::unique_ptr<LayoutAnalyzer> > analyzers;
+	for ( int i = 0 ; i < pool.NumThreads() ; ++i )
+		analyzers.emplace_back( new LayoutAnalyzer( options.metric ) );
+	fprintf( stderr, "Searching layouts with %d vehicles using %d threads\n", options.num_vehicles, pool.NumThreads() );
+
+	// Everything below is protected by lock.  Each thread takes the next
+	// layout, works on it, and then hands in the result.  Results are
+	// written in layout order, so that the output always holds the
+	// results for exactly the layouts before next_to_write.
+	std::mutex lock;
+	uint64_t next_to_start = first_layout;
+	uint64_t next_to_write = first_layout;
+	std::map<uint64_t, std::string> finished;
+	ComponentReport best;
+	std::string best_line;
+	uint64_t puzzles_found = 0;
+	const double start_time = Now();
+	double last_checkpoint = start_time;
+	bool ok = true;
+
+	auto SaveProgress = [&]()
+	{
+		fflush( output );
+		if ( checkpoint_filename && !WriteCheckpoint( checkpoint_filename, options, next_to_write, ftell( output ) ) )
+		{
+			fprintf( stderr, "Can't write %s\n", checkpoint_filename );
+			ok = false;
+		}
+		const double elapsed = Now() - start_time;
+		fprintf( stderr, "...%llu layouts, %.0f per second, %llu puzzles, hardest %d moves\n",
+			(unsigned long long)next_to_write, ( next_to_write - first_layout ) / std::max( elapsed, 1e-6 ),
+			(unsigned long long)puzzles_found, best.moves );
+	};
+
+	pool.ParallelFor( pool.NumThreads(), [&]( int idx_worker )
+	{
+		LayoutAnalyzer &analyzer = *analyzers[idx_worker];
+		std::vector<int> layout;
+		for (;;)
+		{
+			uint64_t idx_layout;
+			{
+				std::lock_guard<std::mutex> guard( lock );
+				if ( !ok || next_to_start - first_layout >= limit || !layouts.Next( layout ) )
+					break;
+				idx_layout = next_to_start++;
+			}
+
+			ComponentReport report;
+			std::string line;
+			if ( analyzer.SetLayout( slots, layout ) && analyzer.Analyze( report ) && report.moves >= options.min_moves )
+			{
+				Board board;
+				analyzer.Vehicles().ToBoard( report.hardest, board );
+				char buf[128];
+				snprintf( buf, sizeof(buf), "%d %s %llu %llu %llu\n", report.moves, BoardToLine( board ).c_str(),
+					(unsigned long long)report.size, (unsigned long long)report.hardest_count, (unsigned long long)report.solutions );
+				line = buf;
+			}
+
+			std::lock_guard<std::mutex> guard( lock );
+			if ( !line.empty() )
+			{
+				++puzzles_found;
+				if ( report.moves > best.moves )
+				{
+					best = report;
+					best_line = line;
+				}
+			}
+			finished[idx_layout] = std::move( line );
+			while ( !finished.empty() && finished.begin()->first == next_to_write )
+			{
+				fputs( finished.begin()->second.c_str(), output );
+				finished.erase( finished.begin() );
+				++next_to_write;
+			}
+			if ( Now() - last_checkpoint >= checkpoint_interval )
+			{
+				SaveProgress();
+				last_checkpoint = Now();
+			}
+		}
+	} );
+
+	SaveProgress();
+	fclose( output );
+	if ( !best_line.empty() )
+		fprintf( stderr, "Hardest: %s", best_line.c_str() );
+	return ok ? 0 : 1;
+}
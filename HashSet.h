@@ -0,0 +1,296 @@
+//
+// Open-addressing hash set, used to remember which board
+// states we have already discovered.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <utility>
+
+#include "Arena.h"
+
+// Mix the bits of a 64-bit value so that every input bit affects
+// every output bit.  (This is the finalizer from MurmurHash3.)
+// Board states have very little entropy in the low bits, so we
+// need a good mix before using the value to pick a slot.
+inline uint64_t HashMix64( uint64_t h )
+{
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdull;
+	h ^= h >> 33;
+	h *= 0xc4ceb9fe1a85ec53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// Each key type used with HashSet must specialize this
+// traits struct, providing:
+//
+//   static uint64_t Hash( const TKey &key );
+//   static bool IsEmpty( const TKey &key );
+//   static TKey Empty();
+//
+// The empty key marks an unused slot, so it must be a value
+// that never occurs as a real key.  Keys must also be comparable
+// with operator==.
+template <typename TKey>
+struct HashSetTraits;
+
+// A set of keys, stored directly in one flat array of slots.
+//
+// Compared to std::set, there are no per-item heap allocations
+// and no pointer chasing.  To find a key we hash it to pick a
+// starting slot, and then scan forward ("linear probing") until
+// we find either the key or an empty slot.  Because we keep
+// the table at most half full, the scan is usually only one or
+// two slots long, and those slots are adjacent in memory.
+//
+// Items cannot be removed individually, only all at once with
+// Clear().  Our search never needs to forget a state, and not
+// supporting removal keeps the probing logic trivial.
+//
+// The slots are allocated with AllocatePages (see Arena.h), so a big
+// table gets huge pages.  Keys must be simple values that can be
+// copied with memcpy.
+template <typename TKey, typename TTraits = HashSetTraits<TKey> >
+class HashSet
+{
+public:
+	HashSet() {}
+
+	// Create a set with enough room for the expected number
+	// of items, so that we won't need to grow it.
+	explicit HashSet( size_t expected_count )
+	{
+		Reserve( expected_count );
+	}
+
+	// Make sure we can hold at least this many items without
+	// growing the table.  (Growing is allowed, it's just
+	// expensive, since every item needs to be reinserted.)
+	void Reserve( size_t expected_count )
+	{
+		const size_t capacity = CapacityFor( expected_count );
+		if ( capacity > m_slots.size() )
+			Rehash( capacity );
+	}
+
+	// Insert the key, if it is not already present.  Returns
+	// true if the key was inserted, or false if it was already
+	// in the set.  (The same meaning as the "second" member of
+	// the value returned by std::set::insert.)
+	bool Insert( const TKey &key )
+	{
+		return FindOrInsert( key ).second;
+	}
+
+	// Like Insert, but also returns a pointer to the item in
+	// the table.  This is useful when the key type carries some
+	// extra data that isn't used for hashing or comparison, which
+	// the caller might want to update.  The pointer is only valid
+	// until the next insertion.
+	std::pair<TKey *, bool> FindOrInsert( const TKey &key )
+	{
+		assert( !TTraits::IsEmpty( key ) );
+
+		// Grow the table if inserting would make it more than
+		// half full.  Note that we might grow even if the key
+		// turns out to already be present.  That's OK.
+		if ( ( m_count + 1 ) * 2 > m_slots.size() )
+			Rehash( m_slots.empty() ? 16 : m_slots.size()*2 );
+
+		size_t idx = TTraits::Hash( key ) & m_mask;
+		for (;;)
+		{
+			TKey &slot = m_slots[idx];
+			if ( TTraits::IsEmpty( slot ) )
+			{
+				slot = key;
+				++m_count;
+				return std::pair<TKey *, bool>( &slot, true );
+			}
+			if ( slot == key )
+				return std::pair<TKey *, bool>( &slot, false );
+			idx = ( idx + 1 ) & m_mask;
+		}
+	}
+
+	// Return a pointer to the item matching the key, or nullptr
+	// if it's not in the set
+	const TKey *Find( const TKey &key ) const
+	{
+		if ( m_count == 0 )
+			return nullptr;
+		size_t idx = TTraits::Hash( key ) & m_mask;
+		for (;;)
+		{
+			const TKey &slot = m_slots[idx];
+			if ( TTraits::IsEmpty( slot ) )
+				return nullptr;
+			if ( slot == key )
+				return &slot;
+			idx = ( idx + 1 ) & m_mask;
+		}
+	}
+
+	// Return true if the key is in the set
+	bool Contains( const TKey &key ) const
+	{
+		return Find( key ) != nullptr;
+	}
+
+	// Number of items in the set
+	size_t size() const { return m_count; }
+
+	// Number of slots, including the empty ones
+	size_t Capacity() const { return m_slots.size(); }
+
+	// See how well spread out the items are.  The probe length of an
+	// item is the number of slots we look at to find it: one, plus
+	// how far it is past the slot it hashes to.  Adds up the probe
+	// lengths, and finds the longest.  This scans the whole table, so
+	// it's only for statistics.  Returns the number of items.
+	size_t MeasureProbes( uint64_t &out_total, uint64_t &out_longest ) const
+	{
+		out_total = out_longest = 0;
+		for ( size_t idx = 0 ; idx < m_slots.size() ; ++idx )
+		{
+			if ( TTraits::IsEmpty( m_slots[idx] ) )
+				continue;
+			const uint64_t length = ( ( idx - TTraits::Hash( m_slots[idx] ) ) & m_mask ) + 1;
+			out_total += length;
+			if ( length > out_longest )
+				out_longest = length;
+		}
+		return m_count;
+	}
+
+	// Call fn( key ) for each item in the set, in no particular order
+	template <typename F>
+	void ForEach( F &&fn ) const
+	{
+		for ( const TKey &slot: m_slots )
+		{
+			if ( !TTraits::IsEmpty( slot ) )
+				fn( slot );
+		}
+	}
+
+	// Exchange contents with another set
+	void Swap( HashSet &x )
+	{
+		m_slots.swap( x.m_slots );
+		std::swap( m_mask, x.m_mask );
+		std::swap( m_count, x.m_count );
+		std::swap( m_oversized_clears, x.m_oversized_clears );
+	}
+
+	// Remove all items, but keep the memory allocated,
+	// so the set can be reused without reallocating.
+	void Clear()
+	{
+		if ( m_count == 0 )
+			return;
+		for ( TKey &slot: m_slots )
+			slot = TTraits::Empty();
+		m_count = 0;
+	}
+
+	// Remove all items, like Clear().  But Clear() has to visit every
+	// slot, so once the table has grown for one huge search, clearing
+	// it would be slow for every small search that came after.  So if
+	// the table has been much bigger than it needed to be for
+	// expected_count items several times in a row, we free it, and
+	// start over with a table of that size.  (Not the first time,
+	// because a fresh table costs more to fill than an old one does
+	// to clear, and the next search might be a big one again.)
+	void ClearAndShrink( size_t expected_count )
+	{
+		const size_t capacity = CapacityFor( expected_count );
+		if ( m_slots.size() <= capacity*SHRINK_FACTOR )
+			m_oversized_clears = 0;
+		else if ( ++m_oversized_clears >= SHRINK_AFTER_CLEARS )
+		{
+			PageArray<TKey>().swap( m_slots );
+			m_mask = 0;
+			m_count = 0;
+			m_oversized_clears = 0;
+			Rehash( capacity );
+			return;
+		}
+		Clear();
+	}
+
+private:
+
+	// ClearAndShrink() frees a table that has been more than
+	// SHRINK_FACTOR times bigger than it needed to be, this
+	// many times in a row
+	static constexpr size_t SHRINK_FACTOR = 8;
+	static constexpr int SHRINK_AFTER_CLEARS = 8;
+
+	// Array of slots.  Size is always a power of two, so
+	// that we can use a mask rather than a modulo.
+	PageArray<TKey> m_slots;
+	size_t m_mask = 0;
+	size_t m_count = 0;
+	int m_oversized_clears = 0;
+
+	// Number of slots we need for this many items, so that
+	// the table is at most half full
+	static size_t CapacityFor( size_t expected_count )
+	{
+		size_t capacity = 16;
+		while ( capacity < expected_count*2 )
+			capacity *= 2;
+		return capacity;
+	}
+
+	// Allocate a new array of slots and reinsert all
+	// the items from the old one.
+	void Rehash( size_t new_capacity )
+	{
+		assert( ( new_capacity & ( new_capacity-1 ) ) == 0 );
+		PageArray<TKey> old_slots( new_capacity );
+		for ( TKey &slot: old_slots )
+			slot = TTraits::Empty();
+		old_slots.swap( m_slots );
+		m_mask = new_capacity-1;
+		for ( const TKey &key: old_slots )
+		{
+			if ( TTraits::IsEmpty( key ) )
+				continue;
+			size_t idx = TTraits::Hash( key ) & m_mask;
+			while ( !TTraits::IsEmpty( m_slots[idx] ) )
+				idx = ( idx + 1 ) & m_mask;
+			m_slots[idx] = key;
+		}
+	}
+};
+
+// Integer keys (such as packed board states) are hashed by
+// mixing their bits.  We reserve the value with all bits set
+// to mark an empty slot.
+template<>
+struct HashSetTraits<uint64_t>
+{
+	static uint64_t Hash( uint64_t key ) { return HashMix64( key ); }
+	static bool IsEmpty( uint64_t key ) { return key == ~0ull; }
+	static uint64_t Empty() { return ~0ull; }
+};
+
+// Board states on the biggest boards need more than 64 bits (see
+// BitBoard.h).  GCC and Clang have a 128-bit integer type.  We hash
+// it by mixing in one half, then the other.
+typedef unsigned __int128 uint128_t;
+template<>
+struct HashSetTraits<uint128_t>
+{
+	static uint64_t Hash( uint128_t key ) { return HashMix64( uint64_t( key ) ^ HashMix64( uint64_t( key >> 64 ) ) ); }
+	static bool IsEmpty( uint128_t key ) { return key == ~uint128_t(0); }
+	static uint128_t Empty() { return ~uint128_t(0); }
+};
@@ -0,0 +1,472 @@
+//
+// Informed search (A* and IDA*) for Rush Hour.
+//
+// Breadth-first search explores every state that is closer to the
+// start than the solution, no matter how hopeless it looks.  An
+// informed search uses a "heuristic": a quick guess of how many
+// moves are still needed from a state.  It explores the states that
+// look most promising first.  As long as the guess never
+// overestimates (the heuristic is "admissible"), the first solution
+// found is still a shortest one.
+//
+
+#pragma once
+
+#include <limits.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <vector>
+
+#include "BitBoard.h"
+
+// The heuristics we know how to compute
+enum class Heuristic
+{
+	// Always guess zero.  A* then behaves like breadth-first search.
+	// Useful as a baseline for comparison.
+	Zero,
+
+	// Distance the goal car still needs to travel, plus one for each
+	// vehicle in its way.  Each of those vehicles needs at least one
+	// move to get out of the way.
+	Blockers,
+
+	// Like Blockers, but look at each blocking vehicle more closely:
+	// how far does it have to move to clear the exit row, and which
+	// other vehicles are in the way of that?
+	BlockersOfBlockers,
+};
+
+// Parse a heuristic name from the command line.  Returns false
+// if the name isn't recognized.
+inline bool ParseHeuristic( const char *name, Heuristic &out )
+{
+	if ( !strcmp( name, "zero" ) )
+		out = Heuristic::Zero;
+	else if ( !strcmp( name, "blockers" ) )
+		out = Heuristic::Blockers;
+	else if ( !strcmp( name, "blockers2" ) )
+		out = Heuristic::BlockersOfBlockers;
+	else
+		return false;
+	return true;
+}
+
+// Estimate returned for a state that cannot be solved at all, for
+// example because an immovable piece is in the way of the goal car.
+constexpr int UNSOLVABLE_ESTIMATE = 1 << 20;
+
+// Return a lower bound on the number of moves needed to solve the
+// puzzle from this state.
+//
+// Every move moves one vehicle one square.  So if we can show that
+// several different vehicles each need to move some number of squares,
+// the total is a lower bound.  The important thing is to never count
+// the same vehicle twice.
+//
+// In the slide metric, a vehicle can go any distance in one move, so
+// all we know is that a vehicle that needs to go somewhere needs at
+// least one move.  Everything else is the same.
+template <typename TVehicleTable>
+inline int EstimateMovesToGoal( const TVehicleTable &vehicles, typename TVehicleTable::PackedState state, Heuristic heuristic )
+{
+	if ( heuristic == Heuristic::Zero )
+		return 0;
+
+	// Number of moves needed to move a vehicle this many squares
+	const bool slide = vehicles.metric == MoveMetric::Slide;
+	auto MovesFor = [slide]( int squares ) { return slide ? std::min( squares, 1 ) : squares; };
+
+	// The goal car needs to drive all the way to the exit
+	const Vehicle &goal = vehicles.vehicle[ vehicles.goal ];
+	const int goal_offset = TVehicleTable::Offset( state, vehicles.goal );
+	int estimate = MovesFor( goal.max_offset - goal_offset );
+
+	// Cells it needs to drive through
+	uint64_t goal_path = 0;
+	for ( int o = goal_offset+1 ; o <= goal.max_offset ; ++o )
+		goal_path |= goal.Mask( o );
+	goal_path &= ~goal.Mask( goal_offset );
+
+	// A wall in the way can never move
+	if ( goal_path & vehicles.walls )
+		return UNSOLVABLE_ESTIMATE;
+
+	// Find the vehicles in the way.  Each one needs at least one move.
+	uint32_t blockers = 0;
+	for ( int v = 0 ; v < vehicles.count ; ++v )
+	{
+		if ( v != vehicles.goal && ( vehicles.VehicleMask( state, v ) & goal_path ) )
+			blockers |= 1u << v;
+	}
+	if ( heuristic == Heuristic::Blockers )
+		return estimate + __builtin_popcount( blockers );
+
+	// Look at each blocker in turn.  Figure out how far it needs to
+	// move to clear the exit row in each direction, and which other
+	// vehicles are in the way of doing that.  The blocker itself needs
+	// at least as many moves as its shortest way out.
+	//
+	// Then, if every way out is obstructed, at least one obstructing
+	// vehicle needs to move, too.  (In fact, all of the vehicles in the
+	// way of the direction it eventually takes.)  But two blockers might
+	// be obstructed by the same vehicle, and we must not count it
+	// twice.  So we only look for obstructions among the vehicles we
+	// haven't counted yet.
+	uint32_t counted = blockers | ( 1u << vehicles.goal );
+	for ( int b = 0 ; b < vehicles.count ; ++b )
+	{
+		if ( !( blockers & ( 1u << b ) ) )
+			continue;
+		const Vehicle &veh = vehicles.vehicle[b];
+		const int offset = TVehicleTable::Offset( state, b );
+		if ( veh.length < 2 )
+			return UNSOLVABLE_ESTIMATE;
+
+		if ( veh.horizontal )
+		{
+			// It's in the exit row, in front of the goal car, so it
+			// has to drive out through the exit.  Anything in its way
+			// is also in the way of the goal car, so already counted.
+			estimate += MovesFor( offset < veh.max_offset ? veh.max_offset - offset : 2 );
+			continue;
+		}
+
+		// Vertical.  It can clear the exit row by moving up until
+		// its bottom is above the row, or down until its top is
+		// below it.
+		const int targets[2] = { TVehicleTable::EXIT_Y - veh.length, TVehicleTable::EXIT_Y + 1 };
+		int best_distance = UNSOLVABLE_ESTIMATE;
+		int fewest_obstructions = UNSOLVABLE_ESTIMATE;
+		uint32_t all_obstructions = 0;
+		const uint64_t m = veh.Mask( offset );
+		for ( int target: targets )
+		{
+			if ( target < 0 || target > veh.max_offset )
+				continue;
+			const int distance = target > offset ? target - offset : offset - target;
+			uint64_t path = 0;
+			for ( int o = std::min( target, offset ) ; o <= std::max( target, offset ) ; ++o )
+				path |= veh.Mask( o );
+			path &= ~m;
+
+			// Can't go this way at all if there's a wall in the way
+			if ( path & vehicles.walls )
+				continue;
+
+			uint32_t obstructions = 0;
+			for ( int v = 0 ; v < vehicles.count ; ++v )
+			{
+				if ( !( counted & ( 1u << v ) ) && ( vehicles.VehicleMask( state, v ) & path ) )
+					obstructions |= 1u << v;
+			}
+			best_distance = std::min( best_distance, distance );
+			fewest_obstructions = std::min( fewest_obstructions, __builtin_popcount( obstructions ) );
+			all_obstructions |= obstructions;
+		}
+		if ( best_distance == UNSOLVABLE_ESTIMATE )
+			return UNSOLVABLE_ESTIMATE;
+		estimate += MovesFor( best_distance );
+
+		// Note that if any way out is unobstructed, fewest_obstructions
+		// is zero, and we don't count anything.  We only looked for
+		// obstructions that haven't been counted already, and once we
+		// count some, we mark all of them as counted.  That may
+		// undercount, but it never counts any vehicle twice.
+		if ( fewest_obstructions > 0 )
+		{
+			estimate += fewest_obstructions;
+			counted |= all_obstructions;
+		}
+	}
+
+	return estimate;
+}
+
+// Result of an informed search
+template <typename TPackedState>
+struct InformedSearchResult
+{
+	typedef TPackedState PackedState;
+
+	// States along the solution, from the initial state to
+	// the solved state.  Empty if there is no solution.
+	std::vector<PackedState> path;
+
+	// Number of states we expanded (generated the moves from)
+	uint64_t nodes_expanded = 0;
+
+	// Number of different states we reached.  IDA* doesn't remember
+	// them all, so it leaves this zero.
+	uint64_t states_discovered = 0;
+
+	// Number of moves we generated from the expanded states
+	uint64_t states_generated = 0;
+};
+
+// A* search.
+//
+// We keep a priority queue of states to explore, ordered by the
+// number of moves to reach the state so far, plus the estimate of
+// moves remaining.  We always explore the state with the smallest
+// total next.  When we take a solved state off the queue, it's a
+// shortest solution.
+//
+// Like BFS, we remember every state we have seen, along with the
+// fewest moves we've found to reach it.  If we later find a shorter
+// way to reach a state, we queue it again.  (That can only happen
+// if the heuristic is inconsistent, meaning that the estimate
+// sometimes drops by more than one in a single move.)
+template <typename TVehicleTable>
+inline InformedSearchResult<typename TVehicleTable::PackedState> SearchAStar( const TVehicleTable &vehicles, typename TVehicleTable::PackedState initial_state, Heuristic heuristic )
+{
+	typedef typename TVehicleTable::PackedState PackedState;
+	typedef typename TVehicleTable::IndexedState IndexedState;
+	InformedSearchResult<PackedState> result;
+
+	// Every state we've reached.  If we find a shorter path to a state,
+	// we add a new node for it, rather than modifying the old one.
+	struct Node
+	{
+		PackedState state;
+		int parent;
+		int moves;
+	};
+	std::vector<Node> nodes;
+
+	// Index of the best node for each state
+	HashSet<IndexedState> best_node;
+
+	// Queue of nodes to explore.  Among nodes with the same total,
+	// prefer the one that has made the most moves, since it is
+	// probably closer to the goal.
+	struct QueueEntry
+	{
+		int total;
+		int moves;
+		int node;
+		bool operator<( const QueueEntry &x ) const
+		{
+			// std::priority_queue returns the largest item first
+			if ( total != x.total )
+				return total > x.total;
+			return moves < x.moves;
+		}
+	};
+	std::priority_queue<QueueEntry> queue;
+
+	nodes.push_back( Node{ initial_state, -1, 0 } );
+	best_node.Insert( IndexedState{ initial_state, 0 } );
+	queue.push( QueueEntry{ EstimateMovesToGoal( vehicles, initial_state, heuristic ), 0, 0 } );
+
+	while ( !queue.empty() )
+	{
+		const int idx_node = queue.top().node;
+		queue.pop();
+		const Node node = nodes[idx_node];
+
+		// Skip it if we found a shorter way here since it was queued
+		if ( best_node.Find( IndexedState{ node.state, -1 } )->index != idx_node )
+			continue;
+
+		if ( vehicles.IsSolved( node.state ) )
+		{
+			for ( int i = idx_node ; i >= 0 ; i = nodes[i].parent )
+				result.path.push_back( nodes[i].state );
+			std::reverse( result.path.begin(), result.path.end() );
+			result.states_discovered = best_node.size();
+			return result;
+		}
+
+		++result.nodes_expanded;
+		vehicles.ForEachMove( node.state, [&]( PackedState next )
+		{
+			++result.states_generated;
+			const int moves = node.moves + 1;
+			std::pair<IndexedState *, bool> entry = best_node.FindOrInsert( IndexedState{ next, (int)nodes.size() } );
+			if ( !entry.second )
+			{
+				if ( nodes[ entry.first->index ].moves <= moves )
+					return;
+				entry.first->index = (int)nodes.size();
+			}
+			nodes.push_back( Node{ next, idx_node, moves } );
+
+			const int estimate = EstimateMovesToGoal( vehicles, next, heuristic );
+			if ( estimate < UNSOLVABLE_ESTIMATE )
+				queue.push( QueueEntry{ moves + estimate, moves, (int)nodes.size()-1 } );
+		} );
+	}
+
+	result.states_discovered = best_node.size();
+	return result;
+}
+
+// Iterative deepening A* (IDA*).
+//
+// A* needs to remember every state it has seen, just like BFS.
+// IDA* instead does a series of depth-first searches, each one
+// abandoning any path where the moves so far plus the estimate
+// exceed a limit.  If a search fails, we raise the limit to the
+// smallest total that went over, and try again.  Since the limit
+// only rises as slowly as possible, the first solution found is a
+// shortest one.
+//
+// A plain depth-first search would waste huge amounts of time
+// re-exploring the same states along different paths.  So we also
+// keep a fixed-size table of the states we've visited during the
+// current pass, and the fewest moves used to reach each one.  If
+// we come back to a state without having done better, there's no
+// need to explore it again.  The table is just a cache: it's split
+// into small buckets, and when a bucket is full, a new state
+// replaces the one that took the most moves to reach.  So memory
+// stays bounded, no matter how big the search.
+//
+// Knowing when to give up on a puzzle with no solution takes some
+// care, since the limit could keep rising forever: a path that goes
+// around in circles can be as long as we like.  So we remember the
+// states where a pass went over the limit.  If, by the end of the
+// pass, every one of them was also reached some other way within the
+// limit (it's in the table), then the pass has explored everything
+// reachable, and there's no solution.  (If there are more reachable
+// states than fit in the table, we can't tell, and will keep trying.)
+//
+// If verbose is set, we print a line at the start of each pass.
+template <typename TVehicleTable>
+inline InformedSearchResult<typename TVehicleTable::PackedState> SearchIDAStar( const TVehicleTable &vehicles, typename TVehicleTable::PackedState initial_state, Heuristic heuristic, bool verbose = false, int table_size_log2 = 20 )
+{
+	typedef typename TVehicleTable::PackedState PackedState;
+	InformedSearchResult<PackedState> result;
+
+	// Table of states visited in the current pass.  Each bucket is
+	// one cache line.
+	struct TableEntry
+	{
+		PackedState state;
+		int moves;
+	};
+	constexpr int BUCKET_SIZE = 4;
+	std::vector<TableEntry> table( size_t(1) << table_size_log2 );
+	const size_t bucket_mask = ( table.size() - 1 ) & ~size_t( BUCKET_SIZE-1 );
+
+	// Find a state in the table, or return nullptr
+	auto FindInTable = [&]( PackedState state ) -> TableEntry *
+	{
+		TableEntry *bucket = &table[ HashSetTraits<PackedState>::Hash( state ) & bucket_mask ];
+		for ( int i = 0 ; i < BUCKET_SIZE ; ++i )
+		{
+			if ( bucket[i].state == state )
+				return &bucket[i];
+		}
+		return nullptr;
+	};
+
+	// Record that we've visited a state.  Returns false if we've
+	// already visited it in no more moves.  (Empty entries have
+	// moves = INT_MAX, so they are always replaced first.)
+	auto Visit = [&]( PackedState state, int moves ) -> bool
+	{
+		TableEntry *bucket = &table[ HashSetTraits<PackedState>::Hash( state ) & bucket_mask ];
+		TableEntry *replace = &bucket[0];
+		for ( int i = 0 ; i < BUCKET_SIZE ; ++i )
+		{
+			if ( bucket[i].state == state )
+			{
+				if ( bucket[i].moves <= moves )
+					return false;
+				replace = &bucket[i];
+				break;
+			}
+			if ( bucket[i].moves > replace->moves )
+				replace = &bucket[i];
+		}
+		replace->state = state;
+		replace->moves = moves;
+		return true;
+	};
+
+	// Current path from the initial state
+	std::vector<PackedState> path;
+	path.push_back( initial_state );
+
+	// States that went over the limit in this pass.  If there are
+	// too many to remember, we just assume there might be a solution.
+	constexpr size_t MAX_CUT_OFF = 1 << 16;
+	HashSet<PackedState> cut_off;
+
+	int limit = EstimateMovesToGoal( vehicles, initial_state, heuristic );
+	int next_limit;
+
+	// Depth-first search from the last state in path.  Returns
+	// true if we found a solution, and leaves it in path.
+	std::function<bool(int)> Search = [&]( int moves ) -> bool
+	{
+		const PackedState state = path.back();
+		const int estimate = EstimateMovesToGoal( vehicles, state, heuristic );
+		if ( estimate >= UNSOLVABLE_ESTIMATE )
+			return false;
+		const int total = moves + estimate;
+		if ( total > limit )
+		{
+			next_limit = std::min( next_limit, total );
+			if ( cut_off.size() <= MAX_CUT_OFF )
+				cut_off.Insert( state );
+			return false;
+		}
+		if ( vehicles.IsSolved( state ) )
+			return true;
+		if ( !Visit( state, moves ) )
+			return false;
+
+		++result.nodes_expanded;
+		PackedState moves_from_here[ TVehicleTable::MAX_MOVES_PER_STATE ];
+		int num_moves = 0;
+		vehicles.ForEachMove( state, [&]( PackedState next ) { moves_from_here[ num_moves++ ] = next; } );
+		result.states_generated += num_moves;
+		for ( int i = 0 ; i < num_moves ; ++i )
+		{
+			path.push_back( moves_from_here[i] );
+			if ( Search( moves+1 ) )
+				return true;
+			path.pop_back();
+		}
+		return false;
+	};
+
+	while ( limit < UNSOLVABLE_ESTIMATE )
+	{
+		if ( verbose )
+			printf( "...IDA* searching with limit %d, expanded %llu states so far\n", limit, (unsigned long long)result.nodes_expanded );
+		for ( TableEntry &e: table )
+		{
+			e.state = HashSetTraits<PackedState>::Empty();
+			e.moves = INT_MAX;
+		}
+		next_limit = UNSOLVABLE_ESTIMATE;
+		cut_off.Clear();
+
+		if ( Search( 0 ) )
+		{
+			result.path = path;
+			return result;
+		}
+
+		// Did we explore everything?
+		bool reached_all = cut_off.size() <= MAX_CUT_OFF;
+		cut_off.ForEach( [&]( PackedState state )
+		{
+			if ( !FindInTable( state ) )
+				reached_all = false;
+		} );
+		if ( reached_all )
+			break;
+
+		limit = next_limit;
+	}
+
+	return result;
+}
@@ -0,0 +1,124 @@
+//
+// Progress messages for long searches.
+//
+// The search used to print a line every 100 states.  On a big search
+// that's tens of thousands of calls to printf, right in the innermost
+// loop, and the search has to wait for each one.  Instead, the search
+// just keeps a few counters up to date, and a separate thread wakes
+// up every so often (four times a second, by default), reads them,
+// and prints a line.  So we get a steady trickle of messages no
+// matter how fast the search is going, and the search never waits
+// for the output.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// Counters that the search updates, and the reporter thread reads.
+// The search is the only one writing them, so it can just store
+// the new values, which on most CPUs is an ordinary write.
+struct SearchProgress
+{
+	// Number of states discovered so far
+	std::atomic<uint64_t> states { 0 };
+
+	// The layer we are expanding, and how many states are in it
+	std::atomic<int> depth { 0 };
+	std::atomic<uint64_t> frontier { 0 };
+
+	void Reset()
+	{
+		SetStates( 0 );
+		SetLayer( 0, 0 );
+	}
+
+	void SetStates( uint64_t count )
+	{
+		states.store( count, std::memory_order_relaxed );
+	}
+
+	void SetLayer( int layer_depth, uint64_t layer_size )
+	{
+		depth.store( layer_depth, std::memory_order_relaxed );
+		frontier.store( layer_size, std::memory_order_relaxed );
+	}
+};
+
+// Prints a progress line every so often, while it exists.  Create
+// one when the search starts, and it stops when it goes out of scope
+// (or when you call Stop).  If the search is over before the first
+// interval is up, nothing is printed at all.
+class ProgressReporter
+{
+public:
+
+	// Start printing the progress every interval_seconds.  If the
+	// interval is 0, don't print anything (and don't start a thread).
+	ProgressReporter( const SearchProgress &progress, double interval_seconds )
+	: m_progress( progress )
+	{
+		if ( interval_seconds > 0.0 )
+			m_thread = std::thread( [this, interval_seconds]() { ReporterThread( interval_seconds ); } );
+	}
+
+	~ProgressReporter()
+	{
+		Stop();
+	}
+
+	// Stop printing, and wait for the thread to finish
+	void Stop()
+	{
+		if ( !m_thread.joinable() )
+			return;
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_stop = true;
+		}
+		m_wake.notify_all();
+		m_thread.join();
+	}
+
+private:
+
+	const SearchProgress &m_progress;
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stop = false;
+
+	void ReporterThread( double interval_seconds )
+	{
+		using namespace std::chrono;
+		const auto interval = duration_cast<steady_clock::duration>( duration<double>( interval_seconds ) );
+		auto last_time = steady_clock::now();
+		uint64_t last_states = 0;
+		std::unique_lock<std::mutex> lock( m_mutex );
+		for (;;)
+		{
+			// Sleep until it's time to print, or we're told to stop
+			if ( m_wake.wait_for( lock, interval, [this]() { return m_stop; } ) )
+				break;
+
+			// The rate is for the last interval, not the whole search,
+			// so it shows how fast we're going now
+			const auto now = steady_clock::now();
+			const uint64_t states = m_progress.states.load( std::memory_order_relaxed );
+			const double rate = ( states - last_states ) / duration<double>( now - last_time ).count();
+			printf( "...%llu states, %.0f per second, depth %d, frontier %llu\n", (unsigned long long)states, rate,
+				m_progress.depth.load( std::memory_order_relaxed ),
+				(unsigned long long)m_progress.frontier.load( std::memory_order_relaxed ) );
+			fflush( stdout );
+			last_time = now;
+			last_states = states;
+		}
+	}
+};
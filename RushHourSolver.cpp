@@ -5,340 +5,523 @@
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
 #include <string.h>
 
-#include <set>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
 #include <vector>
 
-// The rush bour board is 6x6.
-constexpr int BOARD_SIZE = 6;
+#include "DistanceTable.h"
+#include "SolutionCache.h"
+#include "Solver.h"
 
-// Cars can exit the board by moving off to the right on the 3rd
-// row (index 2).
-constexpr int BOARD_EXIT_Y = 2;
-
-// Set this to true to enable dumping of output to show our thinking
-constexpr bool DEBUG_PROGRESS_OUTPUT = false;
-
-// Struct used to describe a particular configuration of cars on the board
-struct Board
+// Print a solution, one board per step, with an arrow
+// showing the move to the next board.
+template <typename TBoard>
+void PrintSolution( const std::vector<TBoard> &path )
 {
-
-	// We represent the board as a simple 2D grid.  Each cell is
-	// a printable-character.  A space character (' ') is used
-	// to denote an empty cell.  Each car should be assigned a unique
-	// character (e.g. letters or numbers).  The goal car we are trying
-	// to get out of the garage must be assigned the character 'X'.
-	//
-	// The array should be indexed [y][x], where y is the row index
-	// and x is the column index
-	char cell[BOARD_SIZE][BOARD_SIZE];
-
-	// Define a comparison operator so we can use std::set to
-	// optimize lookups.
-	//
-	// It doesn't realy matter here exactly what comparison operator
-	// is used.  We just need to establish a valid ordering over
-	// the set of board states.   This choice has the nice property
-	// of being one line of easy-to-understand code that is reasonably
-	// fast.  If we wanted to optimize this, we would probably not
-	// make this function faster, we would just switch to use a hashmap
-	// instead.
-	inline bool operator<( const Board &x ) const
+	for ( int i = 0 ; i < (int)path.size() ; ++i )
 	{
-		return memcmp( cell, x.cell, sizeof(cell) ) < 0;
+		const TBoard *next = i+1 < (int)path.size() ? &path[i+1] : nullptr;
+		printf( "Solution step %d\n", i+1 );
+		path[i].Print( "  ", next );
+		printf( "\n" );
 	}
+}
 
-	// Return the value of cell[y][x].  Assert if we are out of bounds
-	char Cell( int y, int x ) const
+// Explore every state reachable from a board, and save the distance
+// to the goal from each one.  We build the table from the canonical
+// form of the board, so it can be used for the same puzzle with
+// any labels.
+int BuildDistanceTable( const Board &board, const char *filename )
+{
+	DistanceTable table;
+	std::string error;
+	CanonicalBoard canonical;
+	if ( !CanonicalizeBoard( board, canonical ) )
+		canonical.board = board; // Build() will tell us what's wrong with it
+	if ( !table.Build( canonical.board, error ) )
 	{
-		assert( x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE );
-		return cell[y][x];
+		fprintf( stderr, "%s\n", error.c_str() );
+		return 1;
 	}
-
-	// Return the value of cell[y][x], but return 0 if the coords
-	// are off the board
-	char CellSafe( int y, int x ) const
+	if ( !table.Save( filename ) )
 	{
-		if ( x < 0 || x >= BOARD_SIZE || y < 0 || y >= BOARD_SIZE )
-			return 0;
-		return cell[y][x];
+		fprintf( stderr, "Can't write %s\n", filename );
+		return 1;
 	}
+	PackedState state = 0;
+	table.StateFromBoard( canonical.board, state );
+	printf( "Wrote %s: %d states, this board is %d moves from the goal\n", filename, (int)table.size(), table.Distance( state ) );
+	return 0;
+}
 
-	// Set a cell value, with bounds checking
-	void SetCell( int y, int x, char c )
+// Solve one board, and print the solution
+template <typename TGeometry>
+int SolveAndPrint( const BoardT<TGeometry> &initial_board, const SolverOptions &options, bool print_stats, bool stats_json )
+{
+	SolverT<TGeometry> solver( options );
+	SolveResultT<TGeometry> result = solver.Solve( initial_board );
+	if ( result.status == SolveStatus::InvalidBoard || result.status == SolveStatus::Failed )
 	{
-		assert( x >= 0 && x < BOARD_SIZE && y >= 0 && y < BOARD_SIZE );
-		cell[y][x] = c;
+		fprintf( stderr, "%s\n", result.error.c_str() );
+		return 1;
 	}
-
-	// Print this board state.  If there is a next state,
-	// then optionally draw an arrow to show shat the move is
-	void Print( const char *indent, const Board *next ) const
+	if ( !result.from_cache && ( options.algorithm == SearchAlgorithm::AStar || options.algorithm == SearchAlgorithm::IDAStar ) )
+		printf( "Expanded %llu states\n", (unsigned long long)result.states_expanded );
+	if ( result.status == SolveStatus::Solved )
 	{
-		if ( !next ) next = this; // !KLUDGE! If not asking to show the move to the next state, just set next to be same as self
-		for ( int y = 0 ; y < BOARD_SIZE ; ++y )
-		{
-			printf( "%s", indent );
-			for ( int x = 0 ; x < BOARD_SIZE ; ++x )
-			{
+		PrintSolution( result.path );
+	}
+	else
+	{
+		// We've exhausted all possible board states reachable from the
+		// initial position and didn't find a solution.  The puzzle
+		// is not solvable, or we have a bug!
+		printf( "Cannot find solution!\n" );
+	}
 
-				// Assume we won't print an arrow
-				char c = Cell( y, x );
+	if ( print_stats )
+	{
+		if ( stats_json )
+			result.stats.PrintJson( stdout );
+		else
+			result.stats.PrintTable( stdout );
+	}
+	return result.status == SolveStatus::Solved ? 0 : 1;
+}
 
-				// See if next board state differs here
-				char n = next->Cell( y, x );
-				if ( c != n )
-				{
-					if ( c == ' ' )
-					{
-
-						// This is where the move happened.  FIgure which
-						// direction arrow to draw
-						if ( CellSafe( y, x-1 ) == n )
-							c = '>';
-						else if ( CellSafe( y, x+1 ) == n )
-							c = '<';
-						else if ( CellSafe( y-1, x ) == n )
-							c = 'v';
-						else if ( CellSafe( y+1, x ) == n )
-							c = '^';
-						else
-							assert( false ); // Next state is not reachable from this state by a simple move
-					}
-					else if ( n == ' ' && y == BOARD_EXIT_Y && x < BOARD_SIZE-1 )
-					{
-						// Check for the special mode where a car leaves the board entirely
-						bool bCarLeftBoard = true;
-						for ( int xx = x+1 ; xx < BOARD_SIZE ; ++xx )
-						{
-							if ( next->Cell( y, xx ) != ' ' || ( Cell( y, xx ) != ' ' && Cell( y, xx ) != c ) )
-							{
-								bCarLeftBoard = false;
-								break;
-							}
-						}
-						if ( bCarLeftBoard )
-						{
-							while ( x < BOARD_SIZE && c == Cell( y, x ) )
-							{
-								printf( "%c", c );
-								++x;
-							}
-							while ( x < BOARD_SIZE+1 )
-							{
-								printf( ">" );
-								++x;
-							}
-							break;
-						}
-					}
-				}
-				printf( "%c", c );
-			}
-			printf( "\n" );
-		}
+// Solve a board given on the command line, on one of the bigger
+// boards.  (The standard board is handled in main, since it has
+// a few more options.)
+template <typename TGeometry>
+int SolveBiggerBoard( const char *board_text, const SolverOptions &options, bool print_stats, bool stats_json )
+{
+	BoardT<TGeometry> initial_board;
+	if ( !initial_board.Parse( board_text ) )
+	{
+		fprintf( stderr, "Can't parse board '%s'\n", board_text );
+		return 1;
 	}
+	printf( "Initial board state:\n" );
+	initial_board.Print( "  ", nullptr );
+	return SolveAndPrint( initial_board, options, print_stats, stats_json );
+}
+
+// A line read from a batch file, waiting to be parsed
+struct BatchLine
+{
+	int line_number;
+	std::string text;
 };
 
-// List of all board states that we have discovered.
-// The initial state is at index 0.  We use breath-first-search
-// so all the states reachable with 1 move follow the initial state,
-// then all the states reachable with 2 moves, etc.
+// Solve all of the puzzles in a file, one per line, in the format
+// that BoardT::Parse reads.  Blank lines and lines starting with '#'
+// are skipped.  The puzzles are shared out among the threads, and
+// we print one line for each puzzle as soon as it (and all of the
+// puzzles before it) are solved, so the output is always in the
+// same order as the input:
+//
+//   <line number> <moves> <states discovered> <microseconds>
+//
+// The number of moves is -1 if the puzzle can't be solved, and
+// "error" if the line isn't a valid board.
+//
+// Each thread has its own Solver, which keeps its tables from one
+// puzzle to the next.  Once a thread has solved a big puzzle, it
+// already has room for the next one, and we don't spend our time
+// in the memory allocator.  The options are used for every puzzle,
+// except that each puzzle is solved by a single thread.
 //
-// The second item in the pair is the index (into this list)
-// of the previous state that we came from.  This chain is used
-// to reconstruct the path of moves, when we reach the goal state.
-std::vector< std::pair<Board,int> > state_list;
-
-// The same set of states as state_list, but in a data structure
-// that is fast to check if a state is already present.  A std::set
-// optimizes search by using a balanced binary tree.  A hashmap is
-// another option, but that's a bit more code to implement.
-std::set<Board> states_in_list; 
-
-// See if we have been in this state before.  If not, add
-// it to the table of states, which serves as the queue
-// of states we need to explore.  The "from" argument
-// is the index of the state we are coming from.
-void CheckAddState( const Board &state, int from )
+// All of the solvers share one cache, so if the same puzzle comes up
+// again, even with different labels, we don't solve it again.  (The
+// states discovered for it will be 0.)  The cache only works for the
+// standard board.
+template <typename TGeometry>
+int SolveBatch( const char *filename, const std::vector<BatchLine> &lines, int num_threads, SolverOptions options )
 {
-	// Attempt insertion in the fast lookup table
-	// std::set::insert returns a std::pair, and the
-	// "second" memver is a boolean indicating whether
-	// insertion actually happened, or whether insertion
-	// was not performed because an equivalent item
-	// was already in the set.
-	if ( !states_in_list.insert( state ).second )
+	// Parse all of the puzzles
+	struct Puzzle
 	{
+		int line_number;
+		bool parsed;
+		BoardT<TGeometry> board;
+	};
+	std::vector<Puzzle> puzzles;
+	for ( const BatchLine &line: lines )
+	{
+		Puzzle p;
+		p.line_number = line.line_number;
+		p.parsed = p.board.Parse( line.text.c_str() );
+		if ( !p.parsed )
+			fprintf( stderr, "%s(%d): Can't parse board\n", filename, line.line_number );
+		puzzles.push_back( p );
+	}
 
-		// We've already seen this state
-
-		// !TEST! Dump it for debugging
-		if ( DEBUG_PROGRESS_OUTPUT )
+	ThreadPool pool( num_threads );
+	SolutionCache local_cache;
+	options.num_threads = -1;
+	options.verbose = false;
+	if ( !options.cache )
+		options.cache = &local_cache;
+	std::vector< std::unique_ptr< SolverT<TGeometry> > > solvers;
+	for ( int i = 0 ; i < pool.NumThreads() ; ++i )
+		solvers.emplace_back( new SolverT<TGeometry>( options ) );
+	fprintf( stderr, "Solving %d puzzles using %d threads\n", (int)puzzles.size(), pool.NumThreads() );
+
+	// Results, waiting to be printed in order.  Protected by print_lock
+	struct Result
+	{
+		bool done = false;
+		SolveStatus status;
+		std::string error;
+		int moves;
+		uint64_t states_discovered;
+		double seconds;
+	};
+	std::vector<Result> results( puzzles.size() );
+	std::mutex print_lock;
+	size_t next_to_print = 0;
+	int solved_count = 0;
+
+	// Run one loop iteration per worker, and have each worker pull
+	// the next puzzle off the list when it finishes one, so that
+	// each one always uses its own tables.
+	std::atomic<size_t> next_puzzle { 0 };
+	const auto start_time = std::chrono::steady_clock::now();
+	pool.ParallelFor( pool.NumThreads(), [&]( int idx_worker )
+	{
+		SolverT<TGeometry> &solver = *solvers[idx_worker];
+		for (;;)
 		{
-			int idx_found = 0;
-			while ( state_list[idx_found].first < state || state < state_list[idx_found].first )
+			const size_t idx = next_puzzle.fetch_add( 1, std::memory_order_relaxed );
+			if ( idx >= puzzles.size() )
+				break;
+
+			Result r;
+			if ( puzzles[idx].parsed )
+			{
+				SolveResultT<TGeometry> solved = solver.Solve( puzzles[idx].board );
+				r.status = solved.status;
+				r.error = std::move( solved.error );
+				r.moves = solved.depth;
+				r.states_discovered = solved.states_discovered;
+				r.seconds = solved.seconds;
+			}
+			else
 			{
-				++idx_found;
-				assert( idx_found < (int)states_in_list.size() );
+				r.status = SolveStatus::InvalidBoard;
 			}
-			printf( "  Rejected move, already found state %d\n", idx_found );
-			state_list[from].first.Print( "    ", &state );
+			r.done = true;
+
+			std::lock_guard<std::mutex> lock( print_lock );
+			results[idx] = std::move( r );
+			while ( next_to_print < results.size() && results[next_to_print].done )
+			{
+				const Result &p = results[next_to_print];
+				const int line_number = puzzles[next_to_print].line_number;
+				if ( p.status == SolveStatus::InvalidBoard || p.status == SolveStatus::Failed )
+				{
+					if ( !p.error.empty() )
+						fprintf( stderr, "%s(%d): %s\n", filename, line_number, p.error.c_str() );
+					printf( "%d error\n", line_number );
+				}
+				else
+				{
+					printf( "%d %d %llu %.0f\n", line_number, p.moves, (unsigned long long)p.states_discovered, p.seconds*1e6 );
+				}
+				if ( p.status == SolveStatus::Solved )
+					++solved_count;
+				++next_to_print;
+			}
+			fflush( stdout );
 		}
-		return;
-	}
+	} );
+	const double total_sec = std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
 
-	// New board state we haven't seen before.  Add it to the
-	// queue, and remember the previous board state we came from
-	state_list.emplace_back( state, from );
+	fprintf( stderr, "Solved %d of %d puzzles in %.3f seconds (%llu found in cache)\n", solved_count, (int)puzzles.size(), total_sec, (unsigned long long)options.cache->Hits() );
+	return solved_count == (int)puzzles.size() ? 0 : 1;
+}
 
-	// Sanity check invariant that our quick lookup table
-	// is the same size as the simple list.
-	assert( state_list.size() == states_in_list.size() );
+// Read the puzzles in a batch file, and solve them all.  All of the
+// boards in one file are the same size: the size given, or if that's
+// 0, the smallest one that the longest line fits on.
+int RunBatch( const char *filename, int board_size, int num_threads, const SolverOptions &options )
+{
+	FILE *f = fopen( filename, "r" );
+	if ( !f )
+	{
+		fprintf( stderr, "Can't open %s\n", filename );
+		return 1;
+	}
+	std::vector<BatchLine> lines;
+	size_t longest = 0;
+	char line[256];
+	for ( int line_number = 1 ; fgets( line, sizeof(line), f ) ; ++line_number )
+	{
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+		if ( line[0] == '\0' || line[0] == '#' )
+			continue;
+		lines.push_back( BatchLine{ line_number, line } );
+		if ( lines.back().text.size() > lines[longest].text.size() )
+			longest = lines.size()-1;
+	}
+	fclose( f );
 
-	// !TEST! Dump for debugging
-	if ( DEBUG_PROGRESS_OUTPUT && from >= 0 )
+	if ( board_size == 0 )
+		board_size = lines.empty() ? BOARD_SIZE : BoardSizeForText( lines[longest].text.c_str() );
+	switch ( board_size )
 	{
-		printf( "  Added state %d (previous %d)\n", (int)state_list.size()-1, from );
-		state_list[from].first.Print( "    ", &state );
+		case 6: return SolveBatch<Geometry6x6>( filename, lines, num_threads, options );
+		case 7: return SolveBatch<Geometry7x7>( filename, lines, num_threads, options );
+		case 8: return SolveBatch<Geometry8x8>( filename, lines, num_threads, options );
 	}
+
+	// Too long for any board.  Let the standard board complain
+	// about the lines it can't read.
+	return SolveBatch<StandardGeometry>( filename, lines, num_threads, options );
 }
 
-// Recursive helper function to print the solution.
-// i is the index of a state that is on the optimal
-// path of moves.  This function prints all prior moves
-// in order (by calling itself recuseively) and the prints
-// the current move.  It also returns the number of moves
-// that have been printed in total, sio that the move number
-// can be output.
-int PrintSolutionRecursive( int i, const Board *next )
+// Print the command line options
+static void PrintUsage( const char *program )
 {
-	if ( i < 0 )
-		return 0;
-	const Board &cur = state_list[i].first;
-	int step_number = PrintSolutionRecursive( state_list[i].second, &cur )+1;
-	printf( "Solution step %d\n", step_number );
-	cur.Print( "  ", next );
-	printf( "\n" );
-	return step_number;
+	fprintf( stderr, "Usage: %s [--threads N] [--slide] [--frontier] [--external DIR] [--external-memory MB] [--checkpoint FILE [--interval SECONDS]] [--resume] [--bidirectional] [--astar] [--idastar] [--heuristic NAME] [--table FILE] [--progress SECONDS] [--huge-pages] [--stats table|json] [--size N] [--board TEXT] [--batch FILE]\n", program );
+	fprintf( stderr, "       %s [--board TEXT] --build-table FILE\n", program );
+	fprintf( stderr, "  --threads N       Use the parallel search, with N threads (0 = one per core)\n" );
+	fprintf( stderr, "  --slide           Count sliding a car any number of squares as one move, like the cards do\n" );
+	fprintf( stderr, "  --frontier        Use less memory, by only keeping the last few layers of the search\n" );
+	fprintf( stderr, "  --external DIR    Keep the states in files in this directory, instead of in memory\n" );
+	fprintf( stderr, "  --external-memory MB  Memory for sorting new states with --external (default 64)\n" );
+	fprintf( stderr, "  --checkpoint FILE Save the search to FILE every --interval seconds (default 60)\n" );
+	fprintf( stderr, "  --resume          Carry on from the search saved in the --checkpoint file\n" );
+	fprintf( stderr, "  --bidirectional   Search forward from the start and backward from the goal\n" );
+	fprintf( stderr, "  --astar           Use A* search\n" );
+	fprintf( stderr, "  --idastar         Use iterative deepening A* search\n" );
+	fprintf( stderr, "  --heuristic NAME  Heuristic for A* and IDA*: zero, blockers, or blockers2 (default)\n" );
+	fprintf( stderr, "  --board TEXT      Solve this board, given as one line of %d characters (or %d or %d for a bigger board)\n",
+		Geometry6x6::CELLS, Geometry7x7::CELLS, Geometry8x8::CELLS );
+	fprintf( stderr, "  --size N          The board is NxN, where N is 6 (the standard board), 7 or 8\n" );
+	fprintf( stderr, "  --batch FILE      Solve every board in a file, one per line, using --threads N threads\n" );
+	fprintf( stderr, "  --build-table FILE  Find the distance to the goal from every state reachable from the board\n" );
+	fprintf( stderr, "  --table FILE      Look boards up in a table made by --build-table before searching\n" );
+	fprintf( stderr, "  --progress SECONDS  How often to print progress while searching (default 0.25, 0 = never)\n" );
+	fprintf( stderr, "  --huge-pages      Ask for huge pages from the pool set aside in /proc/sys/vm/nr_hugepages\n" );
+	fprintf( stderr, "  --stats FORMAT    Print search statistics at the end, as a table or json (build with -DSEARCH_STATS=1)\n" );
 }
 
-// Check if we can move a car one square in a given direction
-// into the space at x,y, which must be empty.  dx,dy is the
-// direction we will scan from x,y.  The car will move in
-// the opposite direction, into the empty space.
-// 
-// Why are dx,dy passed as template arguments rather than ordinary
-// function arguments?  This is weird, but it ensures that they are
-// compile-time constants and that the compiler treats them as such
-// and generates an optimized function for each of the four
-// search directions.
-//
-// Also the board state is passed by a mutable reference, so that
-// we can temporarily modify it.  However this function is logically
-// constant as we always undo our changes.  We could make a copy,
-// but undoing the changes is faster.
-template <int dx, int dy>
-inline void CheckMove( Board &s, int x, int y, int idx_state )
+int main( int argc, char **argv )
 {
-	// #define an expression that will be true if tx,ty is still
-	// on the board.  Since dx and dy are constants, we use them to
-	// select which of the other checks might actually be necessary.
-	// Exactly one check will be needed; the others will be discarded
-	// at compile time.
-	#define txty_on_board ( \
-		( dx >= 0 || tx >= 0 ) && \
-		( dx <= 0 || tx < BOARD_SIZE ) && \
-		( dy >= 0 || ty >= 0 ) && \
-		( dy <= 0 || ty < BOARD_SIZE ) )
-
-	// Step two squares in the scan direction
-	int tx = x + dx*2;
-	int ty = y + dy*2;
-
-	// Are we still on the board?
-	if ( !(txty_on_board) )
-		return;
-
-	// Check if the two cells have the same value, and it's not a space
-	const char car = s.Cell( ty, tx );
-	if ( s.Cell( ty-dy, tx-dx ) != car || car == ' ' )
-		return;
-
-	// There's a car here we could move.  Find the end.
-	// (The game actually only has cars of 2 or 3, so this
-	// loop will only iterate at most one time.  But if there
-	// was a car of length 4, this loop would be necessary
-	// and work.)
-	do {
-		tx += dx;
-		ty += dy;
-	} while ( (txty_on_board) && s.Cell( ty, tx ) == car );
-	tx -= dx;
-	ty -= dy;
-
-	// Move the car one space, in the opposite direction of dx,dy,
-	// into the empty space.  This only requires changing two grid
-	// cells, no matter how long the car is.
-	s.SetCell( y, x, car );
-	s.SetCell( ty, tx, ' ' );
-
-	// Check if we just moved a car adjacent to the exit ramp,
-	// which is on the right hand side of the board
-	if ( dx == -1 && x == BOARD_SIZE-1 && y == BOARD_EXIT_Y )
-	{
-		// Was it the target car?
-		// Then we have solved the puzzle!
-		if ( car == 'X' )
-		{
 
-			// Add the state.  (This should always succeed!)
-			CheckAddState( s, idx_state );
+	//
+	// Parse command line
+	//
 
-			// And we're done
-			PrintSolutionRecursive( state_list.size()-1, nullptr );
-			exit(0);
-		}
-		else
-		{
-			// Not target car, but we can still move it
-			// completely off the board.  This is always
-			// desirable when possible.
+	// Which search algorithm to use, and how.  We always want
+	// to see the progress.
+	SolverOptions options;
+	options.verbose = true;
 
-			// Erase the car from the board
-			for ( int xx = tx+1 ; xx <= x ; ++xx )
-				s.SetCell( y, xx, ' ' );
+	// Board given on the command line, if any
+	const char *board_text = nullptr;
 
-			// Is this a new board state?
-			CheckAddState( s, idx_state );
+	// Width of the board: 6 (the standard board), 7 or 8.  If this
+	// is 0, it's picked from the length of the board on the command
+	// line, or of the longest line in the batch file.
+	int board_size = 0;
 
-			// Put the car back on the board
-			for ( int xx = tx+1 ; xx <= x ; ++xx )
-				s.SetCell( y, xx, car );
+	// File of puzzles to solve in batch mode, if any
+	const char *batch_filename = nullptr;
+
+	// Distance table to write, or to solve with
+	const char *build_table_filename = nullptr;
+	const char *table_filename = nullptr;
+	SolutionCache cache;
+
+	// Print detailed statistics at the end, as a table or as JSON
+	bool print_stats = false;
+	bool stats_json = false;
+
+	for ( int i = 1 ; i < argc ; ++i )
+	{
+		if ( !strcmp( argv[i], "--threads" ) && i+1 < argc )
+		{
+			options.num_threads = atoi( argv[++i] );
+			if ( options.num_threads < 0 )
+				options.num_threads = 0;
+		}
+		else if ( !strcmp( argv[i], "--bidirectional" ) )
+		{
+			options.algorithm = SearchAlgorithm::Bidirectional;
+		}
+		else if ( !strcmp( argv[i], "--slide" ) )
+		{
+			options.metric = MoveMetric::Slide;
+		}
+		else if ( !strcmp( argv[i], "--frontier" ) )
+		{
+			options.frontier_only = true;
+		}
+		else if ( !strcmp( argv[i], "--external" ) && i+1 < argc )
+		{
+			options.external_dir = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--external-memory" ) && i+1 < argc && atoi( argv[i+1] ) > 0 )
+		{
+			options.external_memory = size_t( atoi( argv[++i] ) ) << 20;
+		}
+		else if ( !strcmp( argv[i], "--checkpoint" ) && i+1 < argc )
+		{
+			options.checkpoint_file = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--interval" ) && i+1 < argc && atof( argv[i+1] ) > 0.0 )
+		{
+			options.checkpoint_interval = atof( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "--resume" ) )
+		{
+			options.resume = true;
+		}
+		else if ( !strcmp( argv[i], "--astar" ) )
+		{
+			options.algorithm = SearchAlgorithm::AStar;
+		}
+		else if ( !strcmp( argv[i], "--idastar" ) )
+		{
+			options.algorithm = SearchAlgorithm::IDAStar;
+		}
+		else if ( !strcmp( argv[i], "--heuristic" ) && i+1 < argc && ParseHeuristic( argv[i+1], options.heuristic ) )
+		{
+			++i;
+		}
+		else if ( !strcmp( argv[i], "--board" ) && i+1 < argc )
+		{
+			board_text = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--size" ) && i+1 < argc && atoi( argv[i+1] ) >= 6 && atoi( argv[i+1] ) <= 8 )
+		{
+			board_size = atoi( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "--batch" ) && i+1 < argc )
+		{
+			batch_filename = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--build-table" ) && i+1 < argc )
+		{
+			build_table_filename = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--table" ) && i+1 < argc )
+		{
+			table_filename = argv[++i];
+		}
+		else if ( !strcmp( argv[i], "--huge-pages" ) )
+		{
+			ArenaHugePages() = true;
+		}
+		else if ( !strcmp( argv[i], "--progress" ) && i+1 < argc )
+		{
+			options.progress_interval = atof( argv[++i] );
+		}
+		else if ( !strcmp( argv[i], "--stats" ) && i+1 < argc && ( !strcmp( argv[i+1], "table" ) || !strcmp( argv[i+1], "json" ) ) )
+		{
+			print_stats = true;
+			stats_json = !strcmp( argv[++i], "json" );
+		}
+		else
+		{
+			PrintUsage( argv[0] );
+			return 1;
 		}
 	}
-	else
+
+	if ( print_stats && !SEARCH_STATS_ENABLED )
 	{
+		fprintf( stderr, "--stats needs the solver to be built with -DSEARCH_STATS=1\n" );
+		return 1;
+	}
 
-		// If this is a new state we haven't sen before, add it to
-		// the queue to explore
-		CheckAddState( s, idx_state );
+	// The tables only know about the standard board
+	if ( board_size == 0 && board_text )
+		board_size = BoardSizeForText( board_text );
+	if ( ( build_table_filename || table_filename ) && board_size != 0 && board_size != BOARD_SIZE )
+	{
+		fprintf( stderr, "--table and --build-table only work with the standard %dx%d board\n", BOARD_SIZE, BOARD_SIZE );
+		return 1;
 	}
 
-	// Undo our changes, moving the car back where it was
-	s.SetCell( y, x, ' ' );
-	s.SetCell( ty, tx, car );
+	// Boards that are in the table are solved by looking them up
+	if ( table_filename )
+	{
+		std::string error;
+		if ( !cache.AddTable( table_filename, error ) )
+		{
+			fprintf( stderr, "%s\n", error.c_str() );
+			return 1;
+		}
+		options.cache = &cache;
+	}
 
-	#undef txty_on_board
-}
+	// In batch mode, each puzzle is solved by one thread, but by
+	// default we use all the cores.
+	if ( batch_filename )
+	{
+		if ( board_text )
+		{
+			fprintf( stderr, "--batch can't be used with --board\n" );
+			return 1;
+		}
+		if ( !options.checkpoint_file.empty() )
+		{
+			fprintf( stderr, "--checkpoint can't be used with --batch\n" );
+			return 1;
+		}
+		return RunBatch( batch_filename, table_filename ? BOARD_SIZE : board_size, std::max( options.num_threads, 0 ), options );
+	}
+	if ( options.algorithm != SearchAlgorithm::BreadthFirst && options.num_threads >= 0 )
+	{
+		fprintf( stderr, "--threads is only supported by the breadth-first search\n" );
+		return 1;
+	}
+	if ( options.frontier_only && ( options.algorithm != SearchAlgorithm::BreadthFirst || options.num_threads >= 0 ) )
+	{
+		fprintf( stderr, "--frontier is only supported by the serial breadth-first search\n" );
+		return 1;
+	}
+	if ( !options.external_dir.empty() && ( options.algorithm != SearchAlgorithm::BreadthFirst || options.num_threads >= 0 || options.frontier_only ) )
+	{
+		fprintf( stderr, "--external is only supported by the serial breadth-first search\n" );
+		return 1;
+	}
+	if ( !options.checkpoint_file.empty() && ( options.algorithm != SearchAlgorithm::BreadthFirst || options.num_threads >= 0
+		|| options.frontier_only || !options.external_dir.empty() ) )
+	{
+		fprintf( stderr, "--checkpoint is only supported by the serial breadth-first search\n" );
+		return 1;
+	}
+	if ( options.resume && options.checkpoint_file.empty() )
+	{
+		fprintf( stderr, "--resume needs --checkpoint FILE\n" );
+		return 1;
+	}
 
-int main()
-{
+	// Bigger boards can only come from the command line
+	if ( ( board_size == 7 || board_size == 8 ) && !board_text )
+	{
+		fprintf( stderr, "--size %d needs --board TEXT\n", board_size );
+		PrintUsage( argv[0] );
+		return 1;
+	}
+	if ( board_size == 7 )
+		return SolveBiggerBoard<Geometry7x7>( board_text, options, print_stats, stats_json );
+	if ( board_size == 8 )
+		return SolveBiggerBoard<Geometry8x8>( board_text, options, print_stats, stats_json );
 
 	//
 	// Setup initial board state
-	// (Uncomment one of the blocks below)
+	// (Pass one on the command line, or uncomment one of the blocks below)
 	//
 
 	Board initial_board;
@@ -382,6 +565,13 @@ int main()
 	memcpy( initial_board.cell[4], "GDH CC", BOARD_SIZE );
 	memcpy( initial_board.cell[5], "G H JJ", BOARD_SIZE );
 
+	// Board from the command line
+	if ( board_text && !initial_board.Parse( board_text ) )
+	{
+		fprintf( stderr, "Can't parse board '%s'\n", board_text );
+		return 1;
+	}
+
 	//
 	// Prepare
 	//
@@ -390,60 +580,10 @@ int main()
 	printf( "Initial board state:\n" );
 	initial_board.Print( "  ", nullptr );
 
-	// Add it as the first (and only) state
-	CheckAddState( initial_board, -1 );
-	assert( state_list.size() == 1 );
-
-	//
-	// Search for solution using breadth-first-search
-	//
-
-	// Keep exploring the frontier of states, until we hit the end of the list.
-	// The list of states also serves as the queue of states to explore.  This
-	// looks like a standard for loop, but it's actually a standard breadth-
-	// first search, since we add new states to the list as they are discovered.
-	for ( int idx_state = 0 ; idx_state < (int)state_list.size() ; ++idx_state )
-	{
-
-		// Grab the next state from the frontier.
-		Board s = state_list[idx_state].first;
-
-		// !TEST! print status
-		if ( DEBUG_PROGRESS_OUTPUT )
-		{
-			printf( "Exploring state %d\n", idx_state );
-			s.Print( "  ", nullptr );
-		}
-		else if ( idx_state % 100 == 0 )
-		{
-			printf( "...explored %d board states\n", idx_state );
-		}
-
-		// Find all states that are reachable from this state by
-		// moving a car a single square.
-		for ( int y = 0 ; y < BOARD_SIZE ; ++y )
-		{
-			for ( int x = 0 ; x < BOARD_SIZE ; ++x )
-			{
-
-				// Is this cell empty?
-				if ( s.Cell( y, x ) != ' ' )
-					continue;
-						
-				// Check for moving a car into the empty space at x,y
-				// from all four directions
-				CheckMove<+1, 0>( s, x, y, idx_state );
-				CheckMove<-1, 0>( s, x, y, idx_state );
-				CheckMove<0, +1>( s, x, y, idx_state );
-				CheckMove<0, -1>( s, x, y, idx_state );
-			}
-		}
-	}
+	// Make a distance table, instead of searching
+	if ( build_table_filename )
+		return BuildDistanceTable( initial_board, build_table_filename );
 
-	// We've exhausted all possible board states reachable from the
-	// initial position and didn't find a solution.  The puzzle
-	// is not solvable, or we have a bug!
-	printf( "Cannot find solution!\n" );
-	return 1;
+	// Search for the solution
+	return SolveAndPrint( initial_board, options, print_stats, stats_json );
 }
-
@@ -0,0 +1,224 @@
+//
+// Detailed statistics about a search.
+//
+// The solver always counts the states it discovers and expands (see
+// SolveResult).  These statistics go further: how many moves led to a
+// state we had already seen, how big each layer of the search was and
+// how long it took, how full the table of visited states got and how
+// far we had to look to find things in it, and how much memory we
+// used.  That's useful when working on the search, but it's extra
+// work in the innermost loops, so it is turned off unless you build
+// with -DSEARCH_STATS=1.  When it's off, all of the code that collects
+// the statistics is thrown away by the compiler, so it costs nothing.
+//
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include <sys/resource.h>
+
+#include <chrono>
+#include <vector>
+
+#ifndef SEARCH_STATS
+	#define SEARCH_STATS 0
+#endif
+
+// True if we are collecting statistics.  Code that collects them
+// is wrapped in "if ( SEARCH_STATS_ENABLED )", so that it is still
+// compiled (and checked) when statistics are off, but optimized away.
+constexpr bool SEARCH_STATS_ENABLED = SEARCH_STATS != 0;
+
+// Forget the process's peak memory use so far, so that PeakMemoryKB
+// measures from here.  This only works on Linux.  Elsewhere, the peak
+// is for the whole run.
+inline void ResetPeakMemory()
+{
+	FILE *f = fopen( "/proc/self/clear_refs", "w" );
+	if ( f )
+	{
+		fputs( "5", f );
+		fclose( f );
+	}
+}
+
+// Peak memory use of the process (resident set size), in KB
+inline long PeakMemoryKB()
+{
+	FILE *f = fopen( "/proc/self/status", "r" );
+	if ( f )
+	{
+		char line[256];
+		long kb = -1;
+		while ( fgets( line, sizeof(line), f ) )
+		{
+			if ( sscanf( line, "VmHWM: %ld", &kb ) == 1 )
+				break;
+		}
+		fclose( f );
+		if ( kb >= 0 )
+			return kb;
+	}
+	struct rusage usage;
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss;
+}
+
+// Statistics for one layer of a breadth-first search: the states
+// that are the same number of moves from where the search started.
+struct SearchLayerStats
+{
+	// Moves from the start.  (For a bidirectional search, from
+	// whichever end this layer belongs to.)
+	int depth = 0;
+
+	// True for a layer of the backward half of a bidirectional search
+	bool backward = false;
+
+	// Number of states in the layer
+	uint64_t frontier = 0;
+
+	// What we did while expanding it
+	uint64_t expanded = 0;
+	uint64_t generated = 0;
+	uint64_t duplicates = 0;
+	double seconds = 0.0;
+};
+
+// Statistics for a whole search
+struct SearchStats
+{
+	// States we generated the moves from
+	uint64_t states_expanded = 0;
+
+	// Moves we generated, and how many of those led to a state
+	// we had already seen
+	uint64_t successors_generated = 0;
+	uint64_t duplicates_rejected = 0;
+
+	// Each layer of a breadth-first search, in the order we
+	// expanded them.  (The informed searches don't have layers.)
+	std::vector<SearchLayerStats> layers;
+
+	// The table(s) of visited states, at the end of the search.
+	// The probe length of a state is the number of slots we look
+	// at to find it, so 1 is the best we can do.
+	uint64_t visited_states = 0;
+	uint64_t visited_slots = 0;
+	uint64_t probe_length_total = 0;
+	uint64_t probe_length_max = 0;
+
+	// How long the search took, and the peak memory of the
+	// whole process at the end
+	double seconds = 0.0;
+	long peak_rss_kb = 0;
+
+	// Forget everything, but keep the memory
+	void Clear()
+	{
+		std::vector<SearchLayerStats> keep;
+		keep.swap( layers );
+		*this = SearchStats();
+		keep.clear();
+		layers.swap( keep );
+	}
+
+	// Start a new layer.  The counters for the previous layer are
+	// worked out from how much the totals went up since it started.
+	void StartLayer( int depth, uint64_t frontier, bool backward = false )
+	{
+		FinishLayer();
+		SearchLayerStats layer;
+		layer.depth = depth;
+		layer.backward = backward;
+		layer.frontier = frontier;
+		layers.push_back( layer );
+		m_layer_expanded = states_expanded;
+		m_layer_generated = successors_generated;
+		m_layer_duplicates = duplicates_rejected;
+		m_layer_start = std::chrono::steady_clock::now();
+	}
+
+	// Finish the current layer, if there is one
+	void FinishLayer()
+	{
+		if ( layers.empty() || m_layer_finished == layers.size() )
+			return;
+		SearchLayerStats &layer = layers.back();
+		layer.expanded = states_expanded - m_layer_expanded;
+		layer.generated = successors_generated - m_layer_generated;
+		layer.duplicates = duplicates_rejected - m_layer_duplicates;
+		layer.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - m_layer_start ).count();
+		m_layer_finished = layers.size();
+	}
+
+	// Add in a table of visited states.  TTable needs Capacity()
+	// and MeasureProbes(), like HashSet.
+	template <typename TTable>
+	void AddVisitedTable( const TTable &table )
+	{
+		uint64_t total = 0, longest = 0;
+		visited_states += table.MeasureProbes( total, longest );
+		visited_slots += table.Capacity();
+		probe_length_total += total;
+		if ( longest > probe_length_max )
+			probe_length_max = longest;
+	}
+
+	double LoadFactor() const { return visited_slots ? double( visited_states ) / visited_slots : 0.0; }
+	double AverageProbeLength() const { return visited_states ? double( probe_length_total ) / visited_states : 0.0; }
+
+	// Print as a human-readable table
+	void PrintTable( FILE *f ) const
+	{
+		fprintf( f, "States expanded:      %llu\n", (unsigned long long)states_expanded );
+		fprintf( f, "Successors generated: %llu\n", (unsigned long long)successors_generated );
+		fprintf( f, "Duplicates rejected:  %llu\n", (unsigned long long)duplicates_rejected );
+		fprintf( f, "Visited table:        %llu states in %llu slots (load %.3f), probe length avg %.3f max %llu\n",
+			(unsigned long long)visited_states, (unsigned long long)visited_slots, LoadFactor(),
+			AverageProbeLength(), (unsigned long long)probe_length_max );
+		fprintf( f, "Search time:          %.3f ms\n", seconds*1e3 );
+		fprintf( f, "Peak RSS:             %ld KB\n", peak_rss_kb );
+		if ( layers.empty() )
+			return;
+		fprintf( f, "%5s %4s %10s %10s %10s %10s %10s\n", "depth", "dir", "frontier", "expanded", "generated", "duplicates", "ms" );
+		for ( const SearchLayerStats &layer: layers )
+		{
+			fprintf( f, "%5d %4s %10llu %10llu %10llu %10llu %10.3f\n", layer.depth, layer.backward ? "bwd" : "fwd",
+				(unsigned long long)layer.frontier, (unsigned long long)layer.expanded,
+				(unsigned long long)layer.generated, (unsigned long long)layer.duplicates, layer.seconds*1e3 );
+		}
+	}
+
+	// Print as a single line of JSON
+	void PrintJson( FILE *f ) const
+	{
+		fprintf( f, "{\"states_expanded\":%llu,\"successors_generated\":%llu,\"duplicates_rejected\":%llu,"
+			"\"visited_states\":%llu,\"visited_slots\":%llu,\"load_factor\":%.4f,\"probe_length_avg\":%.4f,"
+			"\"probe_length_max\":%llu,\"seconds\":%.9f,\"peak_rss_kb\":%ld,\"layers\":[",
+			(unsigned long long)states_expanded, (unsigned long long)successors_generated,
+			(unsigned long long)duplicates_rejected, (unsigned long long)visited_states,
+			(unsigned long long)visited_slots, LoadFactor(), AverageProbeLength(),
+			(unsigned long long)probe_length_max, seconds, peak_rss_kb );
+		for ( size_t i = 0 ; i < layers.size() ; ++i )
+		{
+			const SearchLayerStats &layer = layers[i];
+			fprintf( f, "%s{\"depth\":%d,\"backward\":%s,\"frontier\":%llu,\"expanded\":%llu,\"generated\":%llu,"
+				"\"duplicates\":%llu,\"seconds\":%.9f}", i ? "," : "", layer.depth, layer.backward ? "true" : "false",
+				(unsigned long long)layer.frontier, (unsigned long long)layer.expanded,
+				(unsigned long long)layer.generated, (unsigned long long)layer.duplicates, layer.seconds );
+		}
+		fprintf( f, "]}\n" );
+	}
+
+private:
+
+	// Totals when the current layer started
+	uint64_t m_layer_expanded = 0;
+	uint64_t m_layer_generated = 0;
+	uint64_t m_layer_duplicates = 0;
+	size_t m_layer_finished = 0;
+	std::chrono::steady_clock::time_point m_layer_start;
+};
@@ -0,0 +1,268 @@
+//
+// Cache of puzzles we have already solved
+//
+// The letters on the cars don't matter to the puzzle.  The same
+// puzzle can come to us with the cars labeled differently, because
+// people (and books of puzzles) use whatever letters they like.
+// A board compares the letters, so to the solver those would
+// be different puzzles, and we'd solve them all over again.
+//
+// So before we look anything up, we put the board into a
+// "canonical" form, where the cars are relabeled in a fixed
+// order that only depends on where they are.  Any two boards
+// that are the same puzzle have the same canonical form.  We
+// look that up, and then put the original labels back on the
+// solution, so the caller sees their own letters.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "BitBoard.h"
+#include "DistanceTable.h"
+
+// Labels we give the vehicles in canonical form, in order.  The
+// goal car is always 'X', so we skip that one.
+constexpr char CANONICAL_LABELS[] = "ABCDEFGHIJKLMNOPQRSTUVWYZ";
+static_assert( sizeof(CANONICAL_LABELS)-1 >= MAX_VEHICLES, "Not enough labels" );
+
+// A board in canonical form
+struct CanonicalBoard
+{
+	// The board with the vehicles relabeled
+	Board board;
+
+	// A short string that identifies the puzzle, two bytes per
+	// vehicle.  Two boards have the same key exactly when they
+	// have the same canonical form.
+	std::string key;
+
+	// For each canonical label, the label it had on the original board
+	char original_label[128];
+
+	// Put the original labels back on a board with canonical labels
+	void Restore( Board &b ) const
+	{
+		for ( int y = 0 ; y < BOARD_SIZE ; ++y )
+		{
+			for ( int x = 0 ; x < BOARD_SIZE ; ++x )
+			{
+				const char c = b.cell[y][x];
+				if ( c > ' ' && c < 127 && original_label[(int)c] )
+					b.cell[y][x] = original_label[(int)c];
+			}
+		}
+	}
+};
+
+// Put a board into canonical form.  The goal car stays 'X'.  The
+// other vehicles are sorted by orientation (horizontal first), then
+// length, then track (the row or column they move along), then
+// position along the track, and relabeled in that order.  Walls
+// stay where they are, and are part of the key.
+//
+// Vehicles on the same track can't pass each other, so sliding the
+// vehicles around doesn't change the order.  That means every board
+// we can reach from a canonical board is also canonical, with the same
+// labels, so a distance table built from a canonical board can be
+// used for any of them.  (Unless a car has driven off through the
+// exit.  Then the cars after it move up in the order.)
+//
+// Returns false if the board is not valid.
+inline bool CanonicalizeBoard( const Board &board, CanonicalBoard &out )
+{
+	VehicleTable vehicles;
+	PackedState state;
+	std::string error;
+	if ( !vehicles.Init( board, state, &error ) )
+		return false;
+
+	struct Entry
+	{
+		int v;
+		uint64_t mask;
+		int first_cell;
+		int order[5];
+	};
+	std::vector<Entry> entries( vehicles.count );
+	for ( int v = 0 ; v < vehicles.count ; ++v )
+	{
+		const Vehicle &veh = vehicles.vehicle[v];
+		Entry &e = entries[v];
+		e.v = v;
+		e.mask = vehicles.VehicleMask( state, v );
+		e.first_cell = __builtin_ctzll( e.mask );
+		const int x = e.first_cell % BOARD_SIZE;
+		const int y = e.first_cell / BOARD_SIZE;
+		e.order[0] = v == vehicles.goal ? 0 : 1;
+		e.order[1] = veh.horizontal ? 0 : 1;
+		e.order[2] = veh.length;
+		e.order[3] = veh.horizontal ? y : x;
+		e.order[4] = veh.horizontal ? x : y;
+	}
+	std::sort( entries.begin(), entries.end(), []( const Entry &a, const Entry &b )
+	{
+		return std::lexicographical_compare( a.order, a.order+5, b.order, b.order+5 );
+	} );
+
+	memset( out.board.cell, ' ', sizeof(out.board.cell) );
+	memset( out.original_label, 0, sizeof(out.original_label) );
+	out.key.clear();
+	int next_label = 0;
+	for ( const Entry &e: entries )
+	{
+		const Vehicle &veh = vehicles.vehicle[e.v];
+		const char label = e.v == vehicles.goal ? 'X' : CANONICAL_LABELS[next_label++];
+		out.original_label[(int)label] = veh.label;
+		for ( uint64_t m = e.mask ; m ; m &= m-1 )
+		{
+			const int cell = __builtin_ctzll( m );
+			out.board.cell[cell/BOARD_SIZE][cell%BOARD_SIZE] = label;
+		}
+		out.key.push_back( char( ( veh.horizontal ? 0x80 : 0 ) | veh.length ) );
+		out.key.push_back( char( e.first_cell ) );
+	}
+
+	// Vehicles are never length 0, so a 0 can't be mixed up with one
+	for ( uint64_t m = vehicles.walls ; m ; m &= m-1 )
+	{
+		const int cell = __builtin_ctzll( m );
+		out.board.cell[cell/BOARD_SIZE][cell%BOARD_SIZE] = WALL_CELL;
+		out.key.push_back( 0 );
+		out.key.push_back( char( cell ) );
+	}
+	return true;
+}
+
+// Solutions to puzzles we have seen before, and distance tables
+// we have loaded.  Several solvers (on different threads) can share
+// the same cache.
+class SolutionCache
+{
+public:
+
+	// Use a distance table made by DistanceTable::Save.  Any board
+	// that is part of the same puzzle can be solved from the table.
+	// For the table to match boards with other labels, it should have
+	// been built from a canonical board.
+	bool AddTable( const char *filename, std::string &out_error )
+	{
+		std::unique_ptr<DistanceDatabase> table( new DistanceDatabase );
+		if ( !table->Open( filename, out_error ) )
+			return false;
+		m_tables.push_back( std::move( table ) );
+		return true;
+	}
+
+	// Look for a board in the cache.  If we know the answer,
+	// returns true, and the solution (with the same labels as
+	// the board) in out_path.  If we know there is no solution,
+	// out_path is empty.  The solution is a shortest one in the
+	// given move metric.
+	bool Find( const Board &board, MoveMetric metric, std::vector<Board> &out_path )
+	{
+		CanonicalBoard canonical;
+		if ( !CanonicalizeBoard( board, canonical ) )
+			return false;
+		canonical.key.push_back( (char)metric );
+		out_path.clear();
+
+		// Puzzles we have solved
+		bool found = false;
+		{
+			std::lock_guard<std::mutex> lock( m_lock );
+			auto it = m_solutions.find( canonical.key );
+			if ( it != m_solutions.end() )
+			{
+				out_path = it->second;
+				found = true;
+			}
+		}
+
+		// Tables.  These count moves one square at a time.  We only
+		// use an answer that the table can back up with a solution
+		// (see DistanceDatabase::Solve), and search for the others.
+		for ( size_t i = 0 ; i < m_tables.size() && !found && metric == MoveMetric::Square ; ++i )
+		{
+			const DistanceDatabase &table = *m_tables[i];
+			PackedState state;
+			std::vector<PackedState> solution;
+			if ( !table.StateFromBoard( canonical.board, state ) || !table.Solve( state, solution ) )
+				continue;
+			out_path.resize( solution.size() );
+			for ( size_t j = 0 ; j < solution.size() ; ++j )
+				table.Vehicles().ToBoard( solution[j], out_path[j] );
+			found = true;
+		}
+
+		if ( !found )
+		{
+			m_misses.fetch_add( 1, std::memory_order_relaxed );
+			return false;
+		}
+		m_hits.fetch_add( 1, std::memory_order_relaxed );
+		for ( Board &b: out_path )
+			canonical.Restore( b );
+		return true;
+	}
+
+	// Remember the solution to a board.  An empty path means
+	// there is no solution.
+	void Add( const Board &board, MoveMetric metric, const std::vector<Board> &path )
+	{
+		CanonicalBoard canonical;
+		if ( !CanonicalizeBoard( board, canonical ) )
+			return;
+		canonical.key.push_back( (char)metric );
+
+		// Relabel the solution the same way as the board
+		char canonical_label[128] = {};
+		for ( int c = 0 ; c < 128 ; ++c )
+		{
+			if ( canonical.original_label[c] )
+				canonical_label[(int)canonical.original_label[c]] = (char)c;
+		}
+		std::vector<Board> canonical_path( path );
+		for ( Board &b: canonical_path )
+		{
+			for ( int y = 0 ; y < BOARD_SIZE ; ++y )
+			{
+				for ( int x = 0 ; x < BOARD_SIZE ; ++x )
+				{
+					const char c = b.cell[y][x];
+					if ( c > ' ' && c < 127 && canonical_label[(int)c] )
+						b.cell[y][x] = canonical_label[(int)c];
+				}
+			}
+		}
+
+		std::lock_guard<std::mutex> lock( m_lock );
+		m_solutions.emplace( std::move( canonical.key ), std::move( canonical_path ) );
+	}
+
+	// Number of times Find found, or didn't find, a board
+	uint64_t Hits() const { return m_hits.load( std::memory_order_relaxed ); }
+	uint64_t Misses() const { return m_misses.load( std::memory_order_relaxed ); }
+
+private:
+
+	// Solutions in canonical form, by canonical key.  Protected by m_lock
+	std::mutex m_lock;
+	std::unordered_map<std::string, std::vector<Board>> m_solutions;
+
+	// Tables.  These are read only, so they don't need a lock.
+	std::vector< std::unique_ptr<DistanceDatabase> > m_tables;
+
+	std::atomic<uint64_t> m_hits { 0 };
+	std::atomic<uint64_t> m_misses { 0 };
+};
@@ -0,0 +1,1462 @@
+//
+// Reusable Rush Hour solver.
+//
+// All of the search algorithms, and the tables they need, wrapped
+// up in a class.  You can make as many solvers as you like, and
+// call each one as many times as you like.  Each one keeps its
+// tables between puzzles, so after the first few puzzles it
+// doesn't need to allocate any memory at all.
+//
+
+#pragma once
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "BitBoard.h"
+#include "ConcurrentStateTable.h"
+#include "ExternalSearch.h"
+#include "InformedSearch.h"
+#include "ProgressReporter.h"
+#include "SearchStats.h"
+#include "SolutionCache.h"
+#include "ThreadPool.h"
+
+// Set this to true to enable dumping of output to show our thinking
+constexpr bool DEBUG_PROGRESS_OUTPUT = false;
+
+// How many board states we expect to discover.  We preallocate
+// our tables to be able to hold this many without growing.  (They
+// can still grow if needed, this is just a hint.)  The hardest
+// puzzles that come with the game have a few thousand reachable
+// states, so this is plenty.
+constexpr int EXPECTED_STATE_COUNT = 16384;
+
+// How often the serial breadth-first search checks whether it's time
+// to save a checkpoint, in states.  (Looking at the clock for every
+// state would slow down the hot loop.)  Must be a power of two.
+constexpr int CHECKPOINT_CHECK_STATES = 65536;
+
+// Most of the search time that we spend saving checkpoints.  If a
+// checkpoint takes longer than this fraction of the interval, we wait
+// longer before the next one.
+constexpr double CHECKPOINT_MAX_OVERHEAD = 0.02;
+
+// Which search algorithm to use
+enum class SearchAlgorithm
+{
+	BreadthFirst,
+	Bidirectional,
+	AStar,
+	IDAStar,
+};
+
+// Settings for a Solver
+struct SolverOptions
+{
+	SearchAlgorithm algorithm = SearchAlgorithm::BreadthFirst;
+
+	// Number of threads to use for the breadth-first search.  -1
+	// means to use the simple serial search.  0 means one thread
+	// per core.  The other algorithms always use one thread.
+	int num_threads = -1;
+
+	// Heuristic for the informed searches
+	Heuristic heuristic = Heuristic::BlockersOfBlockers;
+
+	// How to count moves.  The solution is a shortest one when
+	// counted this way.
+	MoveMetric metric = MoveMetric::Square;
+
+	// Use the frontier-only version of the serial breadth-first
+	// search, which needs much less memory, but takes longer to find
+	// the path.  See SearchFrontierOnly.
+	bool frontier_only = false;
+
+	// If set, use the external-memory version of the serial
+	// breadth-first search, which keeps the states in files in this
+	// directory instead of in memory (see ExternalSearch.h), using
+	// external_memory bytes to sort the new states.
+	std::string external_dir;
+	size_t external_memory = size_t(64) << 20;
+
+	// If set, the serial breadth-first search saves everything it
+	// needs to carry on to this file every checkpoint_interval
+	// seconds, so a long search that gets interrupted doesn't have to
+	// start again.  With resume, it starts from the checkpoint in the
+	// file instead of from the beginning.  (The board must be the same.)
+	std::string checkpoint_file;
+	double checkpoint_interval = 60.0;
+	bool resume = false;
+
+	// Print progress messages to stdout while searching
+	bool verbose = false;
+
+	// When verbose, how often to print how the searches are getting
+	// on, in seconds.  0 means never, which also turns off the line
+	// some searches print for each layer.  (See ProgressReporter.h.)
+	double progress_interval = 0.25;
+
+	// If set, look in this cache before searching, and add what we
+	// find to it.  The cache can be shared by several solvers.
+	SolutionCache *cache = nullptr;
+};
+
+// One move of the solution
+struct SolverMove
+{
+	// Which vehicle moved
+	char label;
+
+	// How many squares it moved.  Positive is right or down,
+	// negative is left or up.
+	int distance;
+
+	// True if the vehicle drove off the board through the exit
+	bool exited;
+};
+
+// Outcome of Solver::Solve
+enum class SolveStatus
+{
+	Solved,
+	NoSolution,
+	InvalidBoard,
+
+	// The search couldn't finish, for example because it couldn't
+	// write its files.  (Only the external-memory search and the
+	// checkpoints do any I/O.)
+	Failed,
+};
+
+// Start of a checkpoint file written by the serial breadth-first
+// search.  After the header come the cells of the initial board (so
+// we can check that we're resuming the same puzzle), then the list of
+// states, then the move to each one (see SolverT::m_state_list).  The
+// table of states we've seen isn't saved, since it holds the same
+// states as the list, so we just add them all to it again.
+struct CheckpointFileHeader
+{
+	char magic[4];
+	uint32_t version;
+
+	// Size of the board and of a packed state, and the move metric
+	uint32_t width;
+	uint32_t height;
+	uint32_t state_bytes;
+	uint32_t metric;
+
+	// Where the search is up to: the next state in the list to
+	// expand, and the end and depth of the layer it's in
+	int32_t next_state;
+	int32_t layer_end;
+	int32_t depth;
+	uint32_t unused;
+
+	// Number of states in the list, and the counts so far
+	uint64_t state_count;
+	uint64_t states_expanded;
+	uint64_t states_generated;
+};
+
+constexpr char CHECKPOINT_FILE_MAGIC[4] = { 'R', 'H', 'C', 'P' };
+constexpr uint32_t CHECKPOINT_FILE_VERSION = 1;
+
+// Everything Solver::Solve found out
+template <typename TGeometry>
+struct SolveResultT
+{
+	SolveStatus status = SolveStatus::NoSolution;
+
+	// If the board is not valid, or the search failed, the reason why
+	std::string error;
+
+	// Boards along the solution, starting with the initial board
+	// and ending with the solved one.  Empty if there is no solution.
+	std::vector< BoardT<TGeometry> > path;
+
+	// The moves between the boards in path
+	std::vector<SolverMove> moves;
+
+	// Number of moves in the solution, or -1 if there isn't one
+	int depth = -1;
+
+	// Number of different states discovered, and the number we
+	// generated the moves from.  (IDA* doesn't remember the states
+	// it has seen, so it only reports the second number.)
+	uint64_t states_discovered = 0;
+	uint64_t states_expanded = 0;
+
+	// Number of moves generated, including the ones that led to a
+	// state we had already seen.  For the breadth-first search, this
+	// is the number of times we called CheckAddState to look up a
+	// new move.
+	uint64_t states_generated = 0;
+
+	// How long the search took
+	double seconds = 0.0;
+
+	// True if the solution came from the cache, without searching
+	bool from_cache = false;
+
+	// Detailed statistics.  Only filled in when built with
+	// SEARCH_STATS (see SearchStats.h).
+	SearchStats stats;
+};
+
+typedef SolveResultT<StandardGeometry> SolveResult;
+
+// The solver for one size of board.  Use Solver for the standard
+// board, or SolverT<Geometry7x7> and SolverT<Geometry8x8> for the
+// bigger ones.  (The cache in the options only works for the
+// standard board, and is ignored for the others.)
+template <typename TGeometry>
+class SolverT
+{
+public:
+	typedef BoardT<TGeometry> Board;
+	typedef VehicleTableT<TGeometry> VehicleTable;
+	typedef typename VehicleTable::PackedState PackedState;
+	typedef typename VehicleTable::IndexedState IndexedState;
+	typedef SolveResultT<TGeometry> SolveResult;
+
+	explicit SolverT( const SolverOptions &options = SolverOptions() )
+	: m_options( options )
+	{
+		// Preallocate our tables, so they won't need to grow
+		// (and copy everything) as we discover new states
+		m_state_list.reserve( EXPECTED_STATE_COUNT );
+		m_state_move.reserve( EXPECTED_STATE_COUNT );
+		m_states_in_list.Reserve( EXPECTED_STATE_COUNT );
+	}
+
+	const SolverOptions &Options() const { return m_options; }
+
+	// Table of vehicles from the last board that was solved
+	const VehicleTable &Vehicles() const { return m_vehicles; }
+
+	// Find a shortest solution for a board.  This never prints
+	// anything, unless the verbose option is set.
+	SolveResult Solve( const Board &board )
+	{
+		const auto start_time = std::chrono::steady_clock::now();
+		Reset();
+		SolveResult result;
+
+		// Find the vehicles and convert to packed form
+		PackedState initial_state;
+		if ( !m_vehicles.Init( board, initial_state, &result.error ) )
+		{
+			result.status = SolveStatus::InvalidBoard;
+			return result;
+		}
+		m_vehicles.metric = m_options.metric;
+
+		// Maybe we've already solved this puzzle, perhaps
+		// with different labels
+		if constexpr ( std::is_same<TGeometry, StandardGeometry>::value )
+		{
+			if ( m_options.cache && m_options.cache->Find( board, m_options.metric, result.path ) )
+			{
+				if ( m_options.verbose )
+					printf( "Found solution in cache\n" );
+				result.from_cache = true;
+				if ( !result.path.empty() )
+				{
+					result.status = SolveStatus::Solved;
+					result.depth = (int)result.path.size()-1;
+					PackedState prev = initial_state;
+					for ( int i = 1 ; i < (int)result.path.size() ; ++i )
+					{
+						PackedState next = 0;
+						BoardToTableState( m_vehicles, result.path[i], next );
+						result.moves.push_back( GetMove( prev, next ) );
+						prev = next;
+					}
+				}
+				result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+				return result;
+			}
+		}
+
+		// Report how we're doing from another thread, while we search
+		m_progress.Reset();
+		ProgressReporter reporter( m_progress, m_options.verbose ? m_options.progress_interval : 0.0 );
+
+		std::vector<PackedState> path;
+		if ( m_options.algorithm == SearchAlgorithm::BreadthFirst && !m_options.external_dir.empty() && m_options.num_threads < 0 )
+		{
+			ExternalSearch<VehicleTable> search( m_vehicles, m_options.external_dir, m_options.external_memory, PrintLayers(), &m_progress );
+			ExternalSearchResult<PackedState> external = search.Search( initial_state );
+			if ( !external.error.empty() )
+			{
+				result.status = SolveStatus::Failed;
+				result.error = external.error;
+			}
+			else if ( m_options.verbose )
+			{
+				printf( "Read %.1fMB and wrote %.1fMB of states\n",
+					external.bytes_read / 1048576.0, external.bytes_written / 1048576.0 );
+			}
+			path = std::move( external.path );
+			m_states_discovered = external.states_discovered;
+			m_states_expanded = external.states_expanded;
+			m_states_generated = external.states_generated;
+		}
+		else if ( m_options.algorithm == SearchAlgorithm::BreadthFirst && m_options.frontier_only && m_options.num_threads < 0 )
+		{
+			path = SearchFrontierOnly( initial_state );
+		}
+		else if ( m_options.algorithm == SearchAlgorithm::BreadthFirst )
+		{
+			// Pick up from a checkpoint, or add the initial state
+			// as the first (and only) state
+			SerialPosition start;
+			const bool resume = m_options.resume && !m_options.checkpoint_file.empty() && m_options.num_threads < 0;
+			if ( resume )
+			{
+				if ( !ReadCheckpoint( initial_state, start ) )
+					result.status = SolveStatus::Failed;
+			}
+			else
+			{
+				CheckAddState( initial_state, -1 );
+				assert( m_state_list.size() == 1 );
+			}
+
+			// Already solved?  Otherwise, search for the solution.
+			int idx_solved = 0;
+			if ( result.status == SolveStatus::Failed )
+				idx_solved = -1;
+			else if ( !m_vehicles.IsSolved( initial_state ) )
+				idx_solved = m_options.num_threads >= 0 ? SearchParallel() : SearchSerial( start );
+			StatsFinishLayer();
+			if ( !m_checkpoint_error.empty() )
+			{
+				result.status = SolveStatus::Failed;
+				result.error = m_checkpoint_error;
+			}
+			if ( m_options.verbose && m_checkpoints_written > 0 )
+			{
+				const double search_seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+				printf( "Saved %d checkpoints in %.3f seconds (%.2f%% of the search)\n",
+					m_checkpoints_written, m_checkpoint_seconds, 100.0 * m_checkpoint_seconds / search_seconds );
+			}
+
+			// Follow the chain of previous states back to the start
+			if ( idx_solved >= 0 )
+			{
+				path = TracePath( idx_solved );
+				if ( path.empty() )
+				{
+					result.status = SolveStatus::Failed;
+					result.error = "Can't follow the moves back to the initial board";
+				}
+			}
+			m_states_discovered = m_state_list.size();
+			if ( SEARCH_STATS_ENABLED )
+			{
+				if ( m_options.num_threads >= 0 )
+					m_stats.AddVisitedTable( m_parallel_visited );
+				else
+					m_stats.AddVisitedTable( m_states_in_list );
+			}
+		}
+		else if ( m_options.algorithm == SearchAlgorithm::Bidirectional )
+		{
+			path = SearchBidirectional( initial_state );
+			StatsFinishLayer();
+			if ( SEARCH_STATS_ENABLED )
+			{
+				m_stats.AddVisitedTable( m_fwd.index );
+				m_stats.AddVisitedTable( m_bwd.index );
+			}
+		}
+		else
+		{
+			InformedSearchResult<PackedState> informed = m_options.algorithm == SearchAlgorithm::AStar
+				? SearchAStar( m_vehicles, initial_state, m_options.heuristic )
+				: SearchIDAStar( m_vehicles, initial_state, m_options.heuristic, PrintLayers() );
+			path = std::move( informed.path );
+			m_states_discovered = informed.states_discovered;
+			m_states_expanded = informed.nodes_expanded;
+			m_states_generated = informed.states_generated;
+		}
+		reporter.Stop();
+
+		// Convert the path into boards and moves
+		if ( !path.empty() )
+		{
+			result.status = SolveStatus::Solved;
+			result.depth = (int)path.size()-1;
+			result.path.resize( path.size() );
+			for ( int i = 0 ; i < (int)path.size() ; ++i )
+			{
+				m_vehicles.ToBoard( path[i], result.path[i] );
+				if ( i > 0 )
+					result.moves.push_back( GetMove( path[i-1], path[i] ) );
+			}
+		}
+		if constexpr ( std::is_same<TGeometry, StandardGeometry>::value )
+		{
+			if ( m_options.cache && result.status != SolveStatus::Failed )
+				m_options.cache->Add( board, m_options.metric, result.path );
+		}
+		result.states_discovered = m_states_discovered;
+		result.states_expanded = m_states_expanded;
+		result.states_generated = m_states_generated;
+		result.seconds = std::chrono::duration<double>( std::chrono::steady_clock::now() - start_time ).count();
+		if ( SEARCH_STATS_ENABLED )
+		{
+			SyncStats();
+			m_stats.seconds = result.seconds;
+			m_stats.peak_rss_kb = PeakMemoryKB();
+			result.stats = m_stats;
+		}
+		return result;
+	}
+
+	// Forget everything from the last puzzle.  The tables are
+	// emptied, but keep their memory, so that the next puzzle
+	// doesn't need to allocate it again.  Solve() does this for
+	// you.  (The informed searches still allocate their own
+	// tables for each puzzle.)
+	//
+	// Emptying a table means visiting every slot, though.  If a
+	// table has stayed much bigger than the puzzles need for several
+	// puzzles in a row, because of some huge puzzle before them,
+	// it's freed instead, so that a run of small puzzles stays fast.
+	void Reset()
+	{
+		const size_t keep_count = std::max<size_t>( EXPECTED_STATE_COUNT, m_states_discovered );
+		m_state_list.clear();
+		m_state_move.clear();
+		m_states_in_list.ClearAndShrink( keep_count );
+		m_parallel_visited.ClearAndShrink( keep_count );
+		m_fwd.Clear( keep_count );
+		m_bwd.Clear( keep_count );
+		m_layer.clear();
+		m_next_layer.clear();
+
+		// These don't get a table reserved up front, so they
+		// shrink to whatever the last puzzle needed
+		m_prev_layer_set.ClearAndShrink( m_states_discovered );
+		m_layer_set.ClearAndShrink( m_states_discovered );
+		m_next_layer_set.ClearAndShrink( m_states_discovered );
+		m_exited_visited.ClearAndShrink( m_states_discovered );
+		m_states_discovered = 0;
+		m_states_expanded = 0;
+		m_states_generated = 0;
+		m_checkpoints_written = 0;
+		m_checkpoint_seconds = 0.0;
+		m_checkpoint_error.clear();
+		m_stats.Clear();
+	}
+
+private:
+
+	SolverOptions m_options;
+
+	// Table of vehicles on the board.  This is set up from the
+	// initial board, and is needed to interpret the packed states
+	// and generate moves.
+	VehicleTable m_vehicles;
+
+	// List of all board states that we have discovered.
+	// The initial state is at index 0.  We use breath-first-search
+	// so all the states reachable with 1 move follow the initial state,
+	// then all the states reachable with 2 moves, etc.
+	//
+	// For each state, m_state_move has the move that we made to reach
+	// it (see VehicleTable::MoveCode).  Undoing that move gives us the
+	// previous state that we came from.  This chain is used to
+	// reconstruct the path of moves, when we reach the goal state.
+	//
+	// Each state is a single integer, and the move is one byte, so
+	// each state takes just 9 bytes, compared to 36 bytes for the grid
+	// representation.  (We could store the index of the previous state
+	// instead of the move, but that takes 4 bytes, and the padding
+	// to keep the states aligned takes another 4.)
+	//
+	// These lists can get very long, so they are ChunkedVectors (see
+	// Arena.h), which grow without moving what's already there.
+	ChunkedVector<PackedState> m_state_list;
+	ChunkedVector<uint8_t> m_state_move;
+
+	// The same set of states as m_state_list, but in a data structure
+	// that is fast to check if a state is already present.  We use
+	// a hash table, which usually finds a state by looking at only
+	// one or two slots.  (A std::set would also work, but every
+	// lookup needs to walk down a binary tree, and every insertion
+	// allocates a new tree node.)
+	HashSet<PackedState> m_states_in_list;
+
+	// True if we should print a line as we start each layer (or each
+	// iteration of IDA*).  Like the progress reports, --progress 0
+	// turns these off.
+	bool PrintLayers() const
+	{
+		return m_options.verbose && m_options.progress_interval > 0.0;
+	}
+
+	// Where the serial breadth-first search is up to: the next state
+	// in m_state_list to expand, and the end and depth of the layer
+	// it's in.  Along with the lists, this is everything it needs to
+	// carry on, so it's what we save in a checkpoint.
+	struct SerialPosition
+	{
+		int next_state = 0;
+		int layer_end = 0;
+		int depth = -1;
+	};
+
+	// Checkpoints saved during this search, and how long they took.
+	// If we couldn't save or load one, the reason why.
+	int m_checkpoints_written = 0;
+	double m_checkpoint_seconds = 0.0;
+	std::string m_checkpoint_error;
+
+	// Threads and visited table for the parallel search.  The
+	// threads are started the first time we need them.
+	std::unique_ptr<ThreadPool> m_pool;
+	ConcurrentStateTable m_parallel_visited;
+
+	// A state discovered by the parallel search, and the tag of the
+	// move that reached it.  Each chunk of a layer collects the ones
+	// it found, and then we merge them, using the spare lists in
+	// m_chunk_merged.  The lists are only cleared, never freed, so
+	// once they have grown big enough they don't allocate any more.
+	struct ParallelNewState
+	{
+		uint64_t tag;
+		PackedState state;
+		bool operator<( const ParallelNewState &x ) const { return tag < x.tag; }
+	};
+	std::vector< std::vector<ParallelNewState> > m_chunk_new_states;
+	std::vector< std::vector<ParallelNewState> > m_chunk_merged;
+
+	// One direction of a bidirectional search.  This is the same
+	// idea as m_state_list and m_states_in_list, but the table also
+	// remembers where each state is in the list, so that when the
+	// two searches meet, we can find the path on both sides.
+	struct SearchFrontier
+	{
+		// All states discovered by this side, in breadth-first order,
+		// with the index of the neighboring state we came from, which
+		// is one step closer to where this side started.
+		struct ListEntry
+		{
+			PackedState state;
+			int from;
+		};
+		ChunkedVector<ListEntry> list;
+
+		// Index of every state in the list
+		HashSet<IndexedState> index;
+
+		// Range of the list that makes up the current layer, and
+		// how far those states are from where this side started
+		int layer_begin = 0;
+		int layer_end = 0;
+		int depth = 0;
+
+		// Add a state, if it's new.  Returns true if it was added.
+		bool Add( PackedState state, int from )
+		{
+			if ( !index.Insert( IndexedState{ state, (int)list.size() } ) )
+				return false;
+			list.push_back( ListEntry{ state, from } );
+			return true;
+		}
+
+		// Return the index of a state in the list, or -1
+		int Find( PackedState state ) const
+		{
+			const IndexedState *s = index.Find( IndexedState{ state, -1 } );
+			return s ? s->index : -1;
+		}
+
+		// Start the next layer, consisting of everything added since
+		// the last one
+		void NextLayer()
+		{
+			layer_begin = layer_end;
+			layer_end = (int)list.size();
+			++depth;
+		}
+
+		// Remove everything, but keep the memory, unless the index
+		// is much bigger than keep_count states need
+		void Clear( size_t keep_count )
+		{
+			list.clear();
+			index.ClearAndShrink( keep_count );
+			layer_begin = layer_end = depth = 0;
+		}
+	};
+	SearchFrontier m_fwd, m_bwd;
+
+	// Tables for the frontier-only search.  We only have the layer
+	// we are expanding, and the next one.  Each state also carries
+	// a state from an earlier layer that it came from (see
+	// SearchFrontierOnly).  The sets hold the states in the previous,
+	// current and next layers.  m_exited_visited holds every state
+	// with a vehicle that has exited.
+	struct LayerEntry
+	{
+		PackedState state;
+		PackedState middle;
+	};
+	ChunkedVector<LayerEntry> m_layer, m_next_layer;
+	HashSet<PackedState> m_prev_layer_set, m_layer_set, m_next_layer_set;
+	HashSet<PackedState> m_exited_visited;
+
+	// Statistics for the current search
+	uint64_t m_states_discovered = 0;
+	uint64_t m_states_expanded = 0;
+	uint64_t m_states_generated = 0;
+	SearchStats m_stats;
+
+	// How the search is going, for the progress reporter.  The serial
+	// search updates it for every state, so it only does that when
+	// verbose.  The others only update it once per layer.
+	SearchProgress m_progress;
+
+	// Copy our running totals into m_stats
+	void SyncStats()
+	{
+		m_stats.states_expanded = m_states_expanded;
+		m_stats.successors_generated = m_states_generated;
+	}
+
+	// Start the next layer in m_stats, if we are collecting statistics
+	void StatsStartLayer( int depth, uint64_t frontier, bool backward = false )
+	{
+		if ( !SEARCH_STATS_ENABLED )
+			return;
+		SyncStats();
+		m_stats.StartLayer( depth, frontier, backward );
+	}
+
+	// Finish the last layer in m_stats, when the search is done
+	void StatsFinishLayer()
+	{
+		if ( !SEARCH_STATS_ENABLED )
+			return;
+		SyncStats();
+		m_stats.FinishLayer();
+	}
+
+	// Figure out which move leads from one state to the next
+	SolverMove GetMove( PackedState cur, PackedState next ) const
+	{
+		for ( int v = 0 ; v < m_vehicles.count ; ++v )
+		{
+			const int cur_offset = VehicleTable::Offset( cur, v );
+			const int next_offset = VehicleTable::Offset( next, v );
+			if ( cur_offset == next_offset )
+				continue;
+			const Vehicle &veh = m_vehicles.vehicle[v];
+			if ( next_offset == OFFSET_EXITED )
+			{
+				// It moved up to the last square, and kept going
+				return SolverMove{ veh.label, veh.max_offset - cur_offset, true };
+			}
+			return SolverMove{ veh.label, next_offset - cur_offset, false };
+		}
+		assert( false ); // Not a move
+		return SolverMove{ 0, 0, false };
+	}
+
+	// Print the move from one packed state to another, by
+	// converting them both to the grid form
+	void PrintMove( const char *indent, PackedState cur, PackedState next ) const
+	{
+		Board cur_board, next_board;
+		m_vehicles.ToBoard( cur, cur_board );
+		m_vehicles.ToBoard( next, next_board );
+		cur_board.Print( indent, &next_board );
+	}
+
+	// See if we have been in this state before.  If not, add
+	// it to the table of states, which serves as the queue
+	// of states we need to explore.  The "from" argument
+	// is the index of the state we are coming from.
+	void CheckAddState( PackedState state, int from )
+	{
+		// Attempt insertion in the fast lookup table.
+		// HashSet::Insert returns a boolean indicating whether
+		// insertion actually happened, or whether insertion
+		// was not performed because an equivalent item
+		// was already in the set.
+		if ( !m_states_in_list.Insert( state ) )
+		{
+
+			// We've already seen this state
+			if ( SEARCH_STATS_ENABLED )
+				++m_stats.duplicates_rejected;
+
+			// !TEST! Dump it for debugging
+			if ( DEBUG_PROGRESS_OUTPUT )
+			{
+				int idx_found = 0;
+				while ( !( m_state_list[idx_found] == state ) )
+				{
+					++idx_found;
+					assert( idx_found < (int)m_states_in_list.size() );
+				}
+				printf( "  Rejected move, already found state %d\n", idx_found );
+				PrintMove( "    ", m_state_list[from], state );
+			}
+			return;
+		}
+
+		// New board state we haven't seen before.  Add it to the
+		// queue, and remember the previous board state we came from
+		m_state_list.push_back( state );
+		m_state_move.push_back( from >= 0 ? VehicleTable::MoveCode( m_state_list[from], state ) : VehicleTable::NO_MOVE );
+
+		// Sanity check invariant that our quick lookup table
+		// is the same size as the simple list.
+		assert( m_state_list.size() == m_states_in_list.size() );
+
+		// !TEST! Dump for debugging
+		if ( DEBUG_PROGRESS_OUTPUT && from >= 0 )
+		{
+			printf( "  Added state %d (previous %d)\n", (int)m_state_list.size()-1, from );
+			PrintMove( "    ", m_state_list[from], state );
+		}
+	}
+
+	// Save everything the serial breadth-first search needs to carry
+	// on from where it's up to (see CheckpointFileHeader).  We write a
+	// new file and then rename it over the old one, so that if we're
+	// interrupted while writing, we still have the old checkpoint.
+	bool WriteCheckpoint( const SerialPosition &pos )
+	{
+		CheckpointFileHeader header;
+		memset( &header, 0, sizeof(header) );
+		memcpy( header.magic, CHECKPOINT_FILE_MAGIC, 4 );
+		header.version = CHECKPOINT_FILE_VERSION;
+		header.width = TGeometry::WIDTH;
+		header.height = TGeometry::HEIGHT;
+		header.state_bytes = sizeof(PackedState);
+		header.metric = (uint32_t)m_options.metric;
+		header.next_state = pos.next_state;
+		header.layer_end = pos.layer_end;
+		header.depth = pos.depth;
+		header.state_count = m_state_list.size();
+		header.states_expanded = m_states_expanded;
+		header.states_generated = m_states_generated;
+		Board initial_board;
+		m_vehicles.ToBoard( m_state_list[0], initial_board );
+
+		const std::string temp_filename = m_options.checkpoint_file + ".tmp";
+		FILE *f = fopen( temp_filename.c_str(), "wb" );
+		if ( !f )
+		{
+			m_checkpoint_error = "Can't create " + temp_filename;
+			return false;
+		}
+		bool ok = fwrite( &header, sizeof(header), 1, f ) == 1
+			&& fwrite( initial_board.cell, sizeof(initial_board.cell), 1, f ) == 1;
+
+		// The lists are in chunks, so copy them out a block at a time
+		auto WriteList = [&]( const auto &list )
+		{
+			typedef typename std::decay<decltype( list[0] )>::type T;
+			std::vector<T> block;
+			block.reserve( 8192 );
+			for ( size_t i = 0 ; i < list.size() && ok ; ++i )
+			{
+				block.push_back( list[i] );
+				if ( block.size() == block.capacity() || i+1 == list.size() )
+				{
+					ok = fwrite( block.data(), sizeof(T), block.size(), f ) == block.size();
+					block.clear();
+				}
+			}
+		};
+		WriteList( m_state_list );
+		WriteList( m_state_move );
+		ok = ok && fflush( f ) == 0 && fsync( fileno( f ) ) == 0;
+		ok = ( fclose( f ) == 0 ) && ok;
+		if ( !ok || rename( temp_filename.c_str(), m_options.checkpoint_file.c_str() ) != 0 )
+		{
+			m_checkpoint_error = "Can't write " + m_options.checkpoint_file;
+			return false;
+		}
+		return true;
+	}
+
+	// Load a checkpoint written by WriteCheckpoint, into the lists and
+	// the table of states we've seen, and return where to carry on
+	// from.  Returns false if it can't be read, or was made for a
+	// different puzzle or with different settings.
+	bool ReadCheckpoint( PackedState initial_state, SerialPosition &out_pos )
+	{
+		const std::string &filename = m_options.checkpoint_file;
+		FILE *f = fopen( filename.c_str(), "rb" );
+		if ( !f )
+		{
+			m_checkpoint_error = "Can't open " + filename;
+			return false;
+		}
+		CheckpointFileHeader header;
+		Board initial_board, saved_board;
+		m_vehicles.ToBoard( initial_state, initial_board );
+		bool ok = fread( &header, sizeof(header), 1, f ) == 1
+			&& fread( saved_board.cell, sizeof(saved_board.cell), 1, f ) == 1
+			&& memcmp( header.magic, CHECKPOINT_FILE_MAGIC, 4 ) == 0
+			&& header.version == CHECKPOINT_FILE_VERSION;
+		if ( !ok )
+		{
+			fclose( f );
+			m_checkpoint_error = filename + " is not a search checkpoint";
+			return false;
+		}
+		if ( header.width != (uint32_t)TGeometry::WIDTH || header.height != (uint32_t)TGeometry::HEIGHT
+			|| header.state_bytes != sizeof(PackedState) || header.metric != (uint32_t)m_options.metric
+			|| !( saved_board == initial_board ) )
+		{
+			fclose( f );
+			m_checkpoint_error = filename + " was made for a different board or with different settings";
+			return false;
+		}
+		ok = header.state_count > 0 && header.state_count < uint64_t(1) << 31
+			&& header.next_state >= 0 && (uint64_t)header.next_state <= header.state_count
+			&& header.layer_end >= 0 && (uint64_t)header.layer_end <= header.state_count
+			&& header.depth >= -1;
+		if ( !ok )
+		{
+			fclose( f );
+			m_checkpoint_error = filename + " is damaged";
+			return false;
+		}
+
+		// Read the lists, and add the states to the table.  We know how
+		// many there will be, so make room in the table first.
+		m_states_in_list.Reserve( header.state_count );
+		auto ReadList = [&]( auto &list )
+		{
+			typedef typename std::decay<decltype( list[0] )>::type T;
+			std::vector<T> block( 8192 );
+			for ( uint64_t left = header.state_count ; left > 0 && ok ; )
+			{
+				const size_t n = (size_t)std::min<uint64_t>( left, block.size() );
+				ok = fread( block.data(), sizeof(T), n, f ) == n;
+				for ( size_t i = 0 ; i < n && ok ; ++i )
+					list.push_back( block[i] );
+				left -= n;
+			}
+		};
+		ReadList( m_state_list );
+		ReadList( m_state_move );
+		fclose( f );
+		for ( size_t i = 0 ; i < m_state_list.size() && ok ; ++i )
+			ok = m_states_in_list.Insert( m_state_list[i] );
+
+		// Check the moves too, since we'll follow them back to find the
+		// path.  Only the initial state has no move, and every other
+		// move must be undone to a state we've seen.
+		for ( size_t i = 0 ; i < m_state_move.size() && ok ; ++i )
+		{
+			const uint8_t move = m_state_move[i];
+			if ( i == 0 || move == VehicleTable::NO_MOVE )
+				ok = ( i == 0 ) == ( move == VehicleTable::NO_MOVE );
+			else
+				ok = ( move >> VehicleTable::MOVE_OFFSET_BITS ) < m_vehicles.count
+					&& m_states_in_list.Find( VehicleTable::UndoMove( m_state_list[i], move ) ) != nullptr;
+		}
+		if ( !ok || m_state_list[0] != initial_state )
+		{
+			m_checkpoint_error = filename + " is damaged";
+			return false;
+		}
+		out_pos.next_state = header.next_state;
+		out_pos.layer_end = header.layer_end;
+		out_pos.depth = header.depth;
+		m_states_expanded = header.states_expanded;
+		m_states_generated = header.states_generated;
+		m_progress.SetStates( m_state_list.size() );
+		return true;
+	}
+
+	// Follow the chain of moves back from a state in m_state_list to
+	// the initial state, and return the path from the initial state to
+	// that state.
+	//
+	// Undoing a move tells us the previous state, but not where it is in
+	// the list.  We know it comes earlier in the list, and it's in the
+	// layer just before this one, so we look back from here until we
+	// find it.  Each state on the path is before the one after it, so
+	// altogether we look at each state in the list at most once.
+	//
+	// Returns an empty path if we can't find the previous state, which
+	// can only happen if the list came from a damaged checkpoint.
+	std::vector<PackedState> TracePath( int idx ) const
+	{
+		std::vector<PackedState> path;
+		path.push_back( m_state_list[idx] );
+		while ( m_state_move[idx] != VehicleTable::NO_MOVE )
+		{
+			const PackedState prev = VehicleTable::UndoMove( m_state_list[idx], m_state_move[idx] );
+			do
+			{
+				if ( --idx < 0 )
+					return std::vector<PackedState>();
+			} while ( m_state_list[idx] != prev );
+			path.push_back( prev );
+		}
+		std::reverse( path.begin(), path.end() );
+		return path;
+	}
+
+	// Search for solution using breadth-first-search, starting from
+	// the initial state, which must already be in m_state_list.  Returns
+	// the index of the solved state, or -1 if there is no solution.
+	int SearchSerial( SerialPosition start = SerialPosition() )
+	{
+		// If we're saving checkpoints, when is the next one due?
+		const bool checkpoints = !m_options.checkpoint_file.empty();
+		const auto checkpoint_interval = std::chrono::duration<double>( m_options.checkpoint_interval );
+		auto next_checkpoint = std::chrono::steady_clock::now() + checkpoint_interval;
+
+		// Keep exploring the frontier of states, until we hit the end of the list.
+		// The list of states also serves as the queue of states to explore.  This
+		// looks like a standard for loop, but it's actually a standard breadth-
+		// first search, since we add new states to the list as they are discovered.
+		int layer_end = start.layer_end, depth = start.depth;
+		for ( int idx_state = start.next_state ; idx_state < (int)m_state_list.size() ; ++idx_state )
+		{
+
+			// Grab the next state from the frontier.
+			const PackedState s = m_state_list[idx_state];
+
+			// Starting the next layer?  (We only need to know for
+			// the progress reports, the statistics and the checkpoints.)
+			if ( ( SEARCH_STATS_ENABLED || m_options.verbose || checkpoints ) && idx_state == layer_end )
+			{
+				layer_end = (int)m_state_list.size();
+				m_progress.SetLayer( ++depth, layer_end - idx_state );
+				StatsStartLayer( depth, layer_end - idx_state );
+			}
+
+			// Time to save a checkpoint?  Everything before this state
+			// has been expanded, and everything from here on is still
+			// in the queue, so the list is all we need to carry on.
+			if ( checkpoints && ( idx_state & ( CHECKPOINT_CHECK_STATES-1 ) ) == 0 && std::chrono::steady_clock::now() >= next_checkpoint )
+			{
+				const auto checkpoint_start = std::chrono::steady_clock::now();
+				if ( !WriteCheckpoint( SerialPosition{ idx_state, layer_end, depth } ) )
+					return -1;
+				const auto checkpoint_end = std::chrono::steady_clock::now();
+				const std::chrono::duration<double> took = checkpoint_end - checkpoint_start;
+				++m_checkpoints_written;
+				m_checkpoint_seconds += took.count();
+
+				// The list only gets longer, so each checkpoint takes
+				// longer than the last.  Don't let them take more than
+				// a small part of the time.
+				next_checkpoint = checkpoint_end + std::max( checkpoint_interval, took / CHECKPOINT_MAX_OVERHEAD );
+			}
+
+			// !TEST! print status
+			if ( DEBUG_PROGRESS_OUTPUT )
+			{
+				printf( "Exploring state %d\n", idx_state );
+				PrintMove( "  ", s, s );
+			}
+			else if ( m_options.verbose )
+			{
+				// Don't print anything here!  This loop is the hot
+				// path.  The progress reporter thread does that.
+				m_progress.SetStates( m_state_list.size() );
+			}
+
+			// Find all states that are reachable from this state by
+			// moving a car a single square.
+			bool solved = false;
+			++m_states_expanded;
+			m_vehicles.ForEachMove( s, [&]( PackedState next )
+			{
+				if ( solved )
+					return;
+
+				// Add it to the queue, if it's new
+				++m_states_generated;
+				CheckAddState( next, idx_state );
+
+				// Did we just move the target car to the exit?
+				// Then we have solved the puzzle!  (The state must
+				// be new, since we stop as soon as we find one.)
+				if ( m_vehicles.IsSolved( next ) )
+					solved = true;
+			} );
+
+			if ( solved )
+				return (int)m_state_list.size()-1;
+		}
+
+
+		return -1;
+	}
+
+	// Search for a solution using breadth-first-search, spreading the
+	// work across several threads.
+	//
+	// The search proceeds one layer at a time.  All the states that
+	// are N moves from the start form one contiguous range of
+	// m_state_list.  We split that range into chunks and expand the
+	// chunks in parallel, to find all the states that are N+1 moves
+	// from the start.  Then we wait for all the threads to finish,
+	// append the new layer to m_state_list, and repeat.
+	//
+	// Within a layer, the threads race to discover each new state, so
+	// the order they find them in is random.  But we want the exact
+	// same results as SearchSerial, so we put the new states in the
+	// order that the serial search would have added them.  The serial
+	// search adds a state when it first generates it, which means
+	// from the earliest parent, and the earliest move from that parent.
+	// So we tag each move with ( parent index, move number ), and the
+	// visited table keeps the smallest tag for each state.  Sorting the
+	// new layer by tag then gives us the serial order, and the tag
+	// also tells us the parent.
+	//
+	// The visited table only holds 64-bit states, so on boards with
+	// bigger states, we just use the serial search.
+	int SearchParallel()
+	{
+		if constexpr ( sizeof(PackedState) > sizeof(uint64_t) )
+			return SearchSerial();
+		else
+			return SearchParallel64();
+	}
+	int SearchParallel64()
+	{
+		if ( !m_pool )
+			m_pool.reset( new ThreadPool( m_options.num_threads ) );
+		ThreadPool &pool = *m_pool;
+		if ( m_options.verbose )
+			printf( "Searching using %d threads\n", pool.NumThreads() );
+
+		// Number of bits in a tag used for the move number.  We also
+		// use it to count the moves, so it must hold one more than the
+		// largest move number.
+		constexpr int MOVE_BITS = 7;
+		static_assert( MAX_MOVES_PER_STATE < ( 1 << MOVE_BITS ), "Move count must fit in tag" );
+
+		ConcurrentStateTable &visited = m_parallel_visited;
+		visited.Reserve( EXPECTED_STATE_COUNT );
+		visited.InsertOrLowerTag( m_state_list[0], 0 );
+
+		typedef ParallelNewState NewState;
+		std::vector< std::vector<NewState> > &chunk_new_states = m_chunk_new_states;
+
+		int depth = 0;
+		int layer_begin = 0;
+		while ( layer_begin < (int)m_state_list.size() )
+		{
+			const int layer_end = (int)m_state_list.size();
+			if ( PrintLayers() )
+				printf( "...explored %d board states, depth %d has %d states\n", layer_begin, depth, layer_end - layer_begin );
+			m_progress.SetStates( layer_end );
+			m_progress.SetLayer( depth, layer_end - layer_begin );
+			StatsStartLayer( depth, layer_end - layer_begin );
+
+			// Split the layer into chunks.  Use several chunks per
+			// thread, so that if some chunks take longer than
+			// others, the threads will still finish about the same time.
+			const int layer_size = layer_end - layer_begin;
+			const int num_chunks = std::min( layer_size, pool.NumThreads()*8 );
+
+			// Make sure the visited table has room for the next layer.
+			// It can't grow while the threads are inserting, so we need
+			// to guess.  (If we guess too low, it still works, the extra
+			// states just go into the slower overflow table.)
+			visited.Reserve( m_state_list.size() + layer_size*4 );
+			if ( (int)chunk_new_states.size() < num_chunks )
+			{
+				chunk_new_states.resize( num_chunks );
+				m_chunk_merged.resize( num_chunks );
+			}
+			for ( int chunk = 0 ; chunk < num_chunks ; ++chunk )
+				chunk_new_states[chunk].clear();
+
+			// Expand all the states in the layer.  Each chunk
+			// remembers the states that it inserted into the
+			// visited table first.
+			std::atomic<uint64_t> states_generated { 0 };
+			pool.ParallelFor( num_chunks, [&]( int chunk )
+			{
+				const int begin = layer_begin + int( (int64_t)layer_size * chunk / num_chunks );
+				const int end = layer_begin + int( (int64_t)layer_size * ( chunk+1 ) / num_chunks );
+				std::vector<NewState> &out = chunk_new_states[chunk];
+				uint64_t generated = 0;
+				for ( int idx_state = begin ; idx_state < end ; ++idx_state )
+				{
+					uint64_t tag = uint64_t( idx_state ) << MOVE_BITS;
+					m_vehicles.ForEachMove( m_state_list[idx_state], [&]( PackedState next )
+					{
+						if ( visited.InsertOrLowerTag( next, tag ) )
+							out.push_back( NewState{ tag, next } );
+						++tag;
+					} );
+					generated += tag & ( ( 1 << MOVE_BITS ) - 1 );
+				}
+				states_generated.fetch_add( generated, std::memory_order_relaxed );
+			} );
+			m_states_expanded += layer_size;
+			m_states_generated += states_generated.load( std::memory_order_relaxed );
+
+			// Every move that didn't discover a new state was a duplicate
+			if ( SEARCH_STATS_ENABLED )
+			{
+				uint64_t discovered = 0;
+				for ( int chunk = 0 ; chunk < num_chunks ; ++chunk )
+					discovered += chunk_new_states[chunk].size();
+				m_stats.duplicates_rejected += states_generated.load( std::memory_order_relaxed ) - discovered;
+			}
+
+			// Now that all the inserts are done, look up the final
+			// (smallest) tag for each new state, and sort each chunk.
+			pool.ParallelFor( num_chunks, [&]( int chunk )
+			{
+				for ( NewState &n: chunk_new_states[chunk] )
+					n.tag = visited.Tag( n.state );
+				std::sort( chunk_new_states[chunk].begin(), chunk_new_states[chunk].end() );
+			} );
+
+			// Merge the sorted chunks together.  We merge pairs of
+			// neighboring chunks, then pairs of those, etc.
+			for ( int width = 1 ; width < num_chunks ; width *= 2 )
+			{
+				const int num_pairs = ( num_chunks + width*2 - 1 ) / ( width*2 );
+				pool.ParallelFor( num_pairs, [&]( int pair )
+				{
+					const int a = pair*width*2;
+					const int b = a + width;
+					if ( b >= num_chunks )
+						return;
+					std::vector<NewState> &merged = m_chunk_merged[a];
+					merged.clear();
+					merged.reserve( chunk_new_states[a].size() + chunk_new_states[b].size() );
+					std::merge( chunk_new_states[a].begin(), chunk_new_states[a].end(),
+						chunk_new_states[b].begin(), chunk_new_states[b].end(),
+						std::back_inserter( merged ) );
+					chunk_new_states[a].swap( merged );
+					chunk_new_states[b].clear();
+				} );
+			}
+
+			// Append the new layer, in order.  If it contains a solved
+			// state, the first one is where the serial search would
+			// have stopped.
+			if ( num_chunks > 0 )
+			{
+				for ( const NewState &n: chunk_new_states[0] )
+				{
+					m_state_list.push_back( n.state );
+					m_state_move.push_back( VehicleTable::MoveCode( m_state_list[ n.tag >> MOVE_BITS ], n.state ) );
+					if ( m_vehicles.IsSolved( n.state ) )
+						return (int)m_state_list.size()-1;
+				}
+			}
+
+			layer_begin = layer_end;
+			++depth;
+		}
+
+		return -1;
+	}
+
+	// Search from both ends at once.  One search goes forward from the
+	// initial board, just like SearchSerial.  The other goes backward,
+	// starting from every possible solved board, using ForEachReverseMove.
+	// We always expand whichever side has the smaller layer, and stop as
+	// soon as one side discovers a state that the other side has already
+	// seen.  The path is then the forward path to that state, followed by
+	// the backward path from it.
+	//
+	// Why does this help?  The number of states in a layer tends to
+	// grow with depth.  Two searches that each go half as deep can touch
+	// far fewer states than one search that goes all the way.
+	//
+	// The first meeting point gives a shortest path, because we expand
+	// whole layers at a time.  If the forward side has explored to depth
+	// F and the backward side to depth B without meeting, no path is
+	// shorter than F+B+1 moves.  Expanding the next forward layer finds
+	// states at depth F+1, and any of those that the backward side has
+	// seen are at most B moves from a solved state.
+	//
+	// Returns the path from the initial state, or an empty list if
+	// there is no solution.
+	std::vector<PackedState> SearchBidirectional( PackedState initial_state )
+	{
+		SearchFrontier &fwd = m_fwd, &bwd = m_bwd;
+		fwd.list.reserve( EXPECTED_STATE_COUNT );
+		fwd.index.Reserve( EXPECTED_STATE_COUNT );
+		fwd.Add( initial_state, -1 );
+		fwd.NextLayer();
+		m_vehicles.ForEachSolvedState( [&]( PackedState solved )
+		{
+			bwd.Add( solved, -1 );
+		} );
+		bwd.NextLayer();
+		if ( m_options.verbose )
+			printf( "Searching backward from %d solved states\n", (int)bwd.list.size() );
+
+		// Indices of the meeting point, in each of the lists
+		int meet_fwd = -1, meet_bwd = bwd.Find( initial_state );
+		if ( meet_bwd >= 0 )
+			meet_fwd = 0;
+
+		while ( meet_fwd < 0 )
+		{
+			// Pick the side with the smaller layer.  If either side has
+			// run out of states, there's no solution.
+			const int fwd_size = fwd.layer_end - fwd.layer_begin;
+			const int bwd_size = bwd.layer_end - bwd.layer_begin;
+			if ( fwd_size == 0 || bwd_size == 0 )
+				break;
+			const bool forward = fwd_size <= bwd_size;
+			SearchFrontier &side = forward ? fwd : bwd;
+			const SearchFrontier &other = forward ? bwd : fwd;
+			if ( PrintLayers() )
+			{
+				printf( "...expanding %s depth %d, %d states (forward has %d total, backward %d)\n",
+					forward ? "forward" : "backward", side.depth-1, forward ? fwd_size : bwd_size,
+					(int)fwd.list.size(), (int)bwd.list.size() );
+			}
+			m_progress.SetStates( fwd.list.size() + bwd.list.size() );
+			m_progress.SetLayer( side.depth-1, forward ? fwd_size : bwd_size );
+			StatsStartLayer( side.depth-1, forward ? fwd_size : bwd_size, !forward );
+
+			for ( int idx_state = side.layer_begin ; idx_state < side.layer_end && meet_fwd < 0 ; ++idx_state )
+			{
+				auto Visit = [&]( PackedState next )
+				{
+					++m_states_generated;
+					if ( meet_fwd >= 0 )
+						return;
+					if ( !side.Add( next, idx_state ) )
+					{
+						if ( SEARCH_STATS_ENABLED )
+							++m_stats.duplicates_rejected;
+						return;
+					}
+					int idx_other = other.Find( next );
+					if ( idx_other < 0 )
+						return;
+					meet_fwd = forward ? (int)fwd.list.size()-1 : idx_other;
+					meet_bwd = forward ? idx_other : (int)bwd.list.size()-1;
+				};
+				++m_states_expanded;
+				if ( forward )
+					m_vehicles.ForEachMove( side.list[idx_state].state, Visit );
+				else
+					m_vehicles.ForEachReverseMove( side.list[idx_state].state, Visit );
+			}
+			side.NextLayer();
+		}
+		m_states_discovered = fwd.list.size() + bwd.list.size();
+
+		// Splice the path together.  Walk back from the meeting point to
+		// the initial state, then reverse that.  Then walk from the
+		// meeting point to the solved state.
+		std::vector<PackedState> path;
+		if ( meet_fwd < 0 )
+			return path;
+		for ( int i = meet_fwd ; i >= 0 ; i = fwd.list[i].from )
+			path.push_back( fwd.list[i].state );
+		std::reverse( path.begin(), path.end() );
+		for ( int i = bwd.list[meet_bwd].from ; i >= 0 ; i = bwd.list[i].from )
+			path.push_back( bwd.list[i].state );
+		return path;
+	}
+
+	// Breadth-first search that only keeps a few layers of states, rather
+	// than every state it has ever seen.  On big puzzles, the list of
+	// states is what uses up the memory, and we only keep it so that we
+	// can follow the chain of previous states back from the solution.
+	//
+	// Without the list, how do we know if a state is new?  Every move
+	// can be undone by moving the same vehicle back, so if we can get from
+	// A to B in one move, we can get from B to A in one move.  That means
+	// a state we find from a state N moves from the start can only be
+	// N-1, N or N+1 moves from the start.  It can't be any closer, or we
+	// would have found A sooner, too.  So we only need to check the
+	// previous, current and next layers.  The exception is a vehicle
+	// driving out through the exit, which can't be undone.  So we do
+	// remember every state that has a vehicle missing, in a separate
+	// table.  A state without a missing vehicle can't be reached by an
+	// exit move, so the rule above works for all the others.
+	//
+	// Without the list, how do we find the path?  We do it in pieces
+	// ("divide and conquer").  The first search just finds the solved
+	// state and how far away it is, D moves.  Then we search again,
+	// and this time every state in layer D/2 or later remembers which
+	// state in layer D/2 it came from.  When we reach the solved state
+	// again, we know a state in the middle of the path.  Then we do the
+	// same thing to find the path from the start to the middle, and
+	// from the middle to the end.  Each piece is half as long, so we
+	// search log2(D) times as much, but we never need more memory than
+	// the widest layer (plus the states with a vehicle missing).
+	//
+	// The path is a shortest one, but it might not be the same one
+	// that SearchSerial finds.  Returns the path from the initial
+	// state, or an empty list if there is no solution.
+	std::vector<PackedState> SearchFrontierOnly( PackedState initial_state )
+	{
+		std::vector<PackedState> path;
+		PackedState solved, middle;
+		const int depth = SearchLayers( initial_state, nullptr, -1, solved, middle );
+
+		// The statistics are for the first search.  The searches to
+		// find the path only add to the totals.
+		StatsFinishLayer();
+		if ( SEARCH_STATS_ENABLED )
+		{
+			m_stats.AddVisitedTable( m_prev_layer_set );
+			m_stats.AddVisitedTable( m_layer_set );
+			m_stats.AddVisitedTable( m_next_layer_set );
+			m_stats.AddVisitedTable( m_exited_visited );
+		}
+		if ( depth < 0 )
+			return path;
+		if ( m_options.verbose )
+			printf( "Found solution at depth %d, reconstructing path\n", depth );
+		path.push_back( initial_state );
+		FindPathInPieces( initial_state, solved, depth, path );
+		assert( (int)path.size() == depth+1 );
+		return path;
+	}
+
+	// Find the path between two states that are depth moves apart,
+	// and append it to path, not including the first state.
+	void FindPathInPieces( PackedState from, PackedState to, int depth, std::vector<PackedState> &path )
+	{
+		if ( depth == 0 )
+			return;
+		if ( depth == 1 )
+		{
+			path.push_back( to );
+			return;
+		}
+		const int middle_depth = depth/2;
+		PackedState found, middle;
+		const int found_depth = SearchLayers( from, &to, middle_depth, found, middle );
+		assert( found_depth == depth );
+		(void)found_depth;
+		FindPathInPieces( from, middle, middle_depth, path );
+		FindPathInPieces( middle, to, depth - middle_depth, path );
+	}
+
+	// Add a state to the next layer, if it's new.  Returns true if it was added
+	bool AddToNextLayer( PackedState state )
+	{
+		if ( VehicleTable::HasExitedVehicle( state ) )
+			return m_exited_visited.Insert( state );
+		if ( m_prev_layer_set.Find( state ) || m_layer_set.Find( state ) )
+			return false;
+		return m_next_layer_set.Insert( state );
+	}
+
+	// One frontier-only breadth-first search.  If target is null, stop at
+	// the first solved state, otherwise at the target state.  Returns
+	// the depth of that state, or -1 if we don't find it.  The state we
+	// stopped at is returned in out_found, and the state at middle_depth
+	// on the way there in out_middle.  The states discovered are only
+	// counted for the first search, to match the other searches.
+	int SearchLayers( PackedState start, const PackedState *target, int middle_depth, PackedState &out_found, PackedState &out_middle )
+	{
+		m_layer.clear();
+		m_next_layer.clear();
+		m_prev_layer_set.Clear();
+		m_layer_set.Clear();
+		m_next_layer_set.Clear();
+		m_exited_visited.Clear();
+
+		auto IsTarget = [&]( PackedState state )
+		{
+			return target ? state == *target : m_vehicles.IsSolved( state );
+		};
+
+		AddToNextLayer( start );
+		m_next_layer.push_back( LayerEntry{ start, start } );
+		if ( !target )
+			++m_states_discovered;
+		if ( IsTarget( start ) )
+		{
+			out_found = out_middle = start;
+			return 0;
+		}
+		for ( int depth = 0 ; !m_next_layer.empty() ; ++depth )
+		{
+			// Move on to the next layer.  The previous layer is
+			// no longer needed.
+			m_layer.swap( m_next_layer );
+			m_next_layer.clear();
+			m_prev_layer_set.Swap( m_layer_set );
+			m_layer_set.Swap( m_next_layer_set );
+			m_next_layer_set.Clear();
+			if ( PrintLayers() && !target )
+				printf( "...depth %d, %d states\n", depth, (int)m_layer.size() );
+			if ( !target )
+			{
+				m_progress.SetStates( m_states_discovered );
+				m_progress.SetLayer( depth, m_layer.size() );
+				StatsStartLayer( depth, m_layer.size() );
+			}
+
+			bool found = false;
+			for ( size_t idx_entry = 0 ; idx_entry < m_layer.size() ; ++idx_entry )
+			{
+				const LayerEntry e = m_layer[idx_entry];
+				++m_states_expanded;
+				m_vehicles.ForEachMove( e.state, [&]( PackedState next )
+				{
+					if ( found )
+						return;
+					++m_states_generated;
+					if ( !AddToNextLayer( next ) )
+					{
+						if ( SEARCH_STATS_ENABLED )
+							++m_stats.duplicates_rejected;
+						return;
+					}
+					if ( !target )
+						++m_states_discovered;
+					const PackedState middle = depth+1 == middle_depth ? next : e.middle;
+					m_next_layer.push_back( LayerEntry{ next, middle } );
+
+					// Same as SearchSerial, we stop at the first
+					// one we find
+					if ( IsTarget( next ) )
+					{
+						out_found = next;
+						out_middle = middle;
+						found = true;
+					}
+				} );
+				if ( found )
+					return depth+1;
+			}
+		}
+		return -1;
+	}
+};
+
+// The solver for the standard board
+typedef SolverT<StandardGeometry> Solver;
@@ -0,0 +1,149 @@
+//
+// A very small thread pool, for splitting up a loop across
+// all the cores of the machine.
+//
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// A fixed set of worker threads that can run the iterations of
+// a loop in parallel.  The thread that calls ParallelFor also
+// does some of the work, so a pool of N threads starts N-1
+// workers.
+//
+// We only ever run one loop at a time, and the caller waits for
+// it to finish.  That's all a layer-by-layer search needs, and it
+// keeps this much simpler than a general purpose task queue.
+class ThreadPool
+{
+public:
+
+	// Create a pool with the given number of threads.  Pass 0
+	// to use one thread per core.
+	explicit ThreadPool( int num_threads )
+	{
+		if ( num_threads <= 0 )
+			num_threads = (int)std::thread::hardware_concurrency();
+		if ( num_threads <= 0 )
+			num_threads = 1;
+		m_num_threads = num_threads;
+		for ( int i = 1 ; i < num_threads ; ++i )
+			m_workers.emplace_back( [this]() { WorkerThread(); } );
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_shutdown = true;
+		}
+		m_wake.notify_all();
+		for ( std::thread &t: m_workers )
+			t.join();
+	}
+
+	// Total number of threads that will run a loop, including
+	// the caller.
+	int NumThreads() const { return m_num_threads; }
+
+	// Call fn( i ) for each i in [0,count), spread across all of
+	// the threads.  Returns when all calls have completed.  Each
+	// thread grabs the next index when it finishes the previous
+	// one, so it's a good idea for count to be a few times larger
+	// than the number of threads, to balance the load.
+	//
+	// The threads call fn through a plain function pointer, which
+	// doesn't need to know its type.  (A std::function would do the
+	// same job, but it has to allocate memory to hold a lambda with
+	// more than a couple of captures, every time we start a loop.)
+	template <typename F>
+	void ParallelFor( int count, const F &fn )
+	{
+		if ( count <= 0 )
+			return;
+		const Job job = { []( const void *context, int i ) { (*(const F *)context)( i ); }, &fn };
+
+		// Publish the job and wake up the workers
+		{
+			std::lock_guard<std::mutex> lock( m_mutex );
+			m_job = job;
+			m_job_count = count;
+			m_next_index = 0;
+			m_busy_workers = (int)m_workers.size();
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		// Do our share of the work
+		RunJob( job, count );
+
+		// Wait for the workers to finish theirs
+		std::unique_lock<std::mutex> lock( m_mutex );
+		m_done.wait( lock, [this]() { return m_busy_workers == 0; } );
+		m_job = Job();
+	}
+
+private:
+	int m_num_threads;
+	std::vector<std::thread> m_workers;
+
+	// Current job.  Protected by m_mutex, except for m_next_index,
+	// which the threads use to claim iterations.
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	struct Job
+	{
+		void (*fn)( const void *context, int i ) = nullptr;
+		const void *context = nullptr;
+	};
+	Job m_job;
+	int m_job_count = 0;
+	std::atomic<int> m_next_index { 0 };
+	int m_busy_workers = 0;
+	uint64_t m_generation = 0;
+	bool m_shutdown = false;
+
+	void RunJob( const Job &job, int count )
+	{
+		for (;;)
+		{
+			int i = m_next_index.fetch_add( 1, std::memory_order_relaxed );
+			if ( i >= count )
+				break;
+			job.fn( job.context, i );
+		}
+	}
+
+	void WorkerThread()
+	{
+		uint64_t last_generation = 0;
+		for (;;)
+		{
+			Job job;
+			int count;
+			{
+				std::unique_lock<std::mutex> lock( m_mutex );
+				m_wake.wait( lock, [&]() { return m_shutdown || m_generation != last_generation; } );
+				if ( m_shutdown )
+					return;
+				last_generation = m_generation;
+				job = m_job;
+				count = m_job_count;
+			}
+
+			RunJob( job, count );
+
+			std::lock_guard<std::mutex> lock( m_mutex );
+			if ( --m_busy_workers == 0 )
+				m_done.notify_one();
+		}
+	}
+};